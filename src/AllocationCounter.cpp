@@ -0,0 +1,47 @@
+#include <new>
+#include <cstdlib>
+
+#include "AllocationCounter.hpp"
+
+#if defined(REFLECTHLSL_COUNT_ALLOCATIONS)
+// Constant initialized, so it is safe to touch from operator new at any point of a thread's life
+static thread_local size_t threadAllocations = 0;
+
+namespace ReflectHLSL {
+	size_t AllocationsOnThisThread() {
+		return threadAllocations;
+	}
+}
+
+void* operator new(size_t size) {
+	++threadAllocations;
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	std::free(memory);
+}
+#else
+namespace ReflectHLSL {
+	size_t AllocationsOnThisThread() {
+		return 0;
+	}
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ReflectHLSL {
+	// Whether this build counts allocations, which replaces the global operator new and delete.
+	// Only benchmark builds do, configured with -DREFLECTHLSL_COUNT_ALLOCATIONS=ON.
+#if defined(REFLECTHLSL_COUNT_ALLOCATIONS)
+	constexpr bool AllocationsCounted = true;
+#else
+	constexpr bool AllocationsCounted = false;
+#endif
+
+	// Number of global operator new calls made by the calling thread so far, always 0 if !AllocationsCounted.
+	// Counted by the replacement operator new in AllocationCounter.cpp; subtract two readings to measure a section.
+	size_t AllocationsOnThisThread();
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+#include <type_traits>
+
+namespace ReflectHLSL {
+    // Bump allocator for AST nodes. Nodes are never freed one at a time: Reset destroys
+    // everything allocated since the last Reset in one go and keeps the memory for the next
+    // file. Each thread parses into its own arena, so allocating takes no locks.
+    class AstArena {
+    public:
+        AstArena() = default;
+        ~AstArena() { Reset(); }
+
+        AstArena(AstArena const&) = delete;
+        AstArena& operator=(AstArena const&) = delete;
+
+        static AstArena& ForThisThread() {
+            thread_local AstArena arena;
+            return arena;
+        }
+
+        // Resets the thread's arena when it goes out of scope. Declare it before the AST it
+        // covers, so the AST is destroyed first.
+        class Scope {
+        public:
+            Scope() = default;
+            ~Scope() { AstArena::ForThisThread().Reset(); }
+
+            Scope(Scope const&) = delete;
+            Scope& operator=(Scope const&) = delete;
+        };
+
+        template<typename T, typename... Args>
+        T* New(Args&&... args) {
+            T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            ++Nodes;
+
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                Cleanups = new (Allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup {
+                    [](void* p) { static_cast<T*>(p)->~T(); },
+                    object,
+                    Cleanups
+                };
+            }
+
+            return object;
+        }
+
+        // Destroys every node, newest first, and rewinds to the first block
+        void Reset() {
+            while (Cleanups) {
+                Cleanup* cleanup = Cleanups;
+                Cleanups = cleanup->Next;
+                cleanup->Destroy(cleanup->Object);
+            }
+
+            Current = 0;
+            Used = 0;
+            Nodes = 0;
+        }
+
+        // Nodes and bytes handed out since the last Reset, and bytes held across resets
+        size_t NodeCount() const { return Nodes; }
+        size_t BytesUsed() const {
+            size_t bytes = Used;
+            for (size_t i = 0; i < Current && i < Blocks.size(); ++i) bytes += Blocks[i].Size;
+            return bytes;
+        }
+        size_t BytesReserved() const {
+            size_t bytes = 0;
+            for (auto const& block : Blocks) bytes += block.Size;
+            return bytes;
+        }
+
+        // Raw memory, given back only by Reset
+        void* Allocate(size_t size, size_t alignment) {
+            // Blocks kept from earlier files are filled before new ones are made
+            for (; Current < Blocks.size(); ++Current, Used = 0) {
+                if (void* memory = TryAllocate(Blocks[Current], size, alignment)) return memory;
+            }
+
+            Block block;
+            block.Size = std::max(BlockSize, size + alignment);
+            block.Memory = std::make_unique<std::byte[]>(block.Size);
+            Blocks.push_back(std::move(block));
+            Current = Blocks.size() - 1;
+            Used = 0;
+            return TryAllocate(Blocks.back(), size, alignment);
+        }
+
+    private:
+        static constexpr size_t BlockSize = 64 * 1024;
+
+        struct Cleanup {
+            void (*Destroy)(void*);
+            void* Object;
+            Cleanup* Next;
+        };
+
+        struct Block {
+            std::unique_ptr<std::byte[]> Memory;
+            size_t Size = 0;
+        };
+
+        void* TryAllocate(Block& block, size_t size, size_t alignment) {
+            const uintptr_t base = reinterpret_cast<uintptr_t>(block.Memory.get());
+            const size_t offset = ((base + Used + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (offset + size > block.Size) return nullptr;
+
+            Used = offset + size;
+            return block.Memory.get() + offset;
+        }
+
+        std::vector<Block> Blocks;
+        size_t Current = 0;
+        size_t Used = 0;
+        size_t Nodes = 0;
+        Cleanup* Cleanups = nullptr;
+    };
+
+    // Allocator handing out memory of an AstArena. Deallocating does nothing; the memory is reused
+    // after the arena's next Reset.
+    template<typename T>
+    struct ArenaAllocator {
+        using value_type = T;
+
+        explicit ArenaAllocator(AstArena& arena) : Arena(&arena) { }
+        template<typename U>
+        ArenaAllocator(ArenaAllocator<U> const& other) : Arena(other.Arena) { }
+
+        T* allocate(size_t count) { return static_cast<T*>(Arena->Allocate(count * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) { }
+
+        template<typename U>
+        bool operator==(ArenaAllocator<U> const& other) const { return Arena == other.Arena; }
+
+        AstArena* Arena;
+    };
+
+    // List whose elements and header live in the thread's AstArena, so building one costs no heap
+    // allocations. Moving a list hands its storage over, which is what a grammar reduction like
+    // `list.push_back(x); return list;` does, so building an N element list is linear. Copying a
+    // list copies its elements into storage of its own.
+    template<typename T>
+    class ArenaList {
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = T const*;
+
+        ArenaList() = default;
+        ArenaList(std::initializer_list<T> items) {
+            for (auto const& item : items) push_back(item);
+        }
+
+        ArenaList(ArenaList const& other) {
+            if (other.empty()) return;
+            Storage().reserve(other.size());
+            for (auto const& item : other) push_back(item);
+        }
+        ArenaList(ArenaList&& other) noexcept : Items(std::exchange(other.Items, nullptr)) { }
+
+        ArenaList& operator=(ArenaList other) noexcept {
+            std::swap(Items, other.Items);
+            return *this;
+        }
+
+        void push_back(T const& item) { Storage().push_back(item); }
+        void push_back(T&& item) { Storage().push_back(std::move(item)); }
+
+        iterator erase(const_iterator first, const_iterator last) {
+            if (!Items || first == last) return const_cast<iterator>(first);
+            auto& items = *Items;
+            const auto offset = first - items.data();
+            items.erase(items.begin() + offset, items.begin() + (last - items.data()));
+            return items.data() + offset;
+        }
+
+        size_t size() const { return Items ? Items->size() : 0; }
+        bool empty() const { return size() == 0; }
+
+        iterator begin() { return Items ? Items->data() : nullptr; }
+        iterator end() { return begin() + size(); }
+        const_iterator begin() const { return Items ? Items->data() : nullptr; }
+        const_iterator end() const { return begin() + size(); }
+
+        T& operator[](size_t i) { return (*Items)[i]; }
+        T const& operator[](size_t i) const { return (*Items)[i]; }
+        T& back() { return Items->back(); }
+        T const& back() const { return Items->back(); }
+
+    private:
+        using Vector = std::vector<T, ArenaAllocator<T>>;
+
+        Vector& Storage() {
+            if (!Items) {
+                AstArena& arena = AstArena::ForThisThread();
+                Items = arena.New<Vector>(ArenaAllocator<T>(arena));
+            }
+            return *Items;
+        }
+
+        Vector* Items = nullptr;
+    };
+}
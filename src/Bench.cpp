@@ -0,0 +1,1116 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <cstring>
+#include <cctype>
+
+#include "Bench.hpp"
+#include "HLSL.hpp"
+#include "Tool.hpp"
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "Preprocessor.hpp"
+#include "AllocationCounter.hpp"
+#include "Dispatch.hpp"
+#include "MappedBufferConfig.hpp"
+
+// Every generated file declares the Generator template, so each goes in a namespace of its own, after the
+// types they share are declared at global scope.
+#include "ReflectHLSLRuntime.hpp"
+
+// Generated with -cpu from test/blend.comp, test/smooth.comp and test/tint.comp
+namespace BlendShader {
+#include "../test/blend.comp.inl"
+}
+namespace SmoothShader {
+#include "../test/smooth.comp.inl"
+}
+namespace TintShader {
+#include "../test/tint.comp.inl"
+}
+// Generated with -dirty from test/scene.comp
+namespace SceneShader {
+#include "../test/scene.comp.inl"
+}
+// Generated from test/nested.comp
+namespace NestedShader {
+#include "../test/nested.comp.inl"
+}
+// Generated from test/diffuse.comp and test/specular.comp, which both include test/light.hlsli
+namespace DiffuseShader {
+#include "../test/diffuse.comp.inl"
+}
+namespace SpecularShader {
+#include "../test/specular.comp.inl"
+}
+
+namespace ReflectHLSL {
+	using BenchClock = std::chrono::steady_clock;
+
+	static double ElapsedMs(BenchClock::time_point start) {
+		return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+	}
+
+	template<typename F>
+	static double MeasureMs(F&& f) {
+		const auto start = BenchClock::now();
+		f();
+		return ElapsedMs(start);
+	}
+
+	static std::filesystem::path BenchInput(std::vector<std::string> const& args, size_t index) {
+		return args.size() > index ? std::filesystem::path(args[index]) : std::filesystem::path("test/shaders.comp");
+	}
+
+	static size_t BenchCount(std::vector<std::string> const& args, size_t index, size_t fallback) {
+		return args.size() > index ? std::stoul(args[index]) : fallback;
+	}
+
+	static std::string PrepareSource(std::filesystem::path const& path) {
+		IncludeCache includes;
+		const std::vector<std::filesystem::path> includeDirs;
+		const DefinesContext defines;
+
+		std::string source;
+		Preprocessor(includes, includeDirs, defines).Run(path, MappedFile(path).View(), source);
+		return source;
+	}
+
+	// Printed for heap allocations by a build that doesn't count them
+	static constexpr const char* NotCounted = "not counted, configure with -DREFLECTHLSL_COUNT_ALLOCATIONS=ON\n";
+
+	// Parses and throws the AST away, releasing its arena nodes
+	static void ParseOnce(SharedParser::Handle& parser, std::string const& source) {
+		AstArena::Scope scope;
+		parser.Parse(source);
+	}
+
+	// Setup cost of the grammar and tables vs. the cost of one parse.
+	// Usage: -bench parser [file] [iterations]
+	static int BenchParser(std::vector<std::string> const& args) {
+		const std::filesystem::path input = BenchInput(args, 1);
+		const size_t iterations = BenchCount(args, 2, 100);
+		const std::string source = PrepareSource(input);
+
+		const double coldSetup = MeasureMs([]() { SharedParser::Parser parser; });
+		const double prototypeSetup = MeasureMs([]() { SharedParser::Prototype(); });
+
+		// What each thread pays for a copy of the tables, when it parses with one
+		double copyMs = 0.0;
+		size_t copyAllocations = 0;
+		if constexpr (SharedParser::CopiesTables) {
+			const size_t before = AllocationsOnThisThread();
+			copyMs = MeasureMs([]() { [[maybe_unused]] SharedParser::Parser copy = SharedParser::Prototype(); });
+			copyAllocations = AllocationsOnThisThread() - before;
+		}
+
+		// The first parse on a thread also pays for that thread's copy of the prototype, if it has one
+		double firstParse = 0.0;
+		std::thread([&]() {
+			firstParse = MeasureMs([&]() { ParseOnce(SharedParser::ForThisThread(), source); });
+		}).join();
+
+		auto& parser = SharedParser::ForThisThread();
+		ParseOnce(parser, source);
+		const double warmParse = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				ParseOnce(parser, source);
+			}
+		}) / static_cast<double>(iterations);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "parser: " << input.string() << " (" << source.size() << " bytes)\n"
+			<< "  new parser per file (old path): " << coldSetup + warmParse << " ms/file\n"
+			<< "  grammar + table setup:          " << prototypeSetup << " ms (once per process)\n"
+			<< "  first parse on a new thread:    " << firstParse << " ms\n"
+			<< "  parse with shared tables:       " << warmParse << " ms/file\n";
+		if constexpr (SharedParser::SharesTables) {
+			std::cout << "  tables per thread:              none, every thread parses with the prototype\n";
+		} else if constexpr (SharedParser::CopiesTables) {
+			std::cout << "  copy of the tables per thread:  " << copyMs << " ms, ";
+			if (AllocationsCounted) {
+				std::cout << copyAllocations << " heap allocations\n";
+			} else {
+				std::cout << NotCounted;
+			}
+		} else {
+			std::cout << "  tables per thread:              built again, the parser can't be copied\n";
+		}
+
+		// The same parse from every hardware thread at once, each with what ForThisThread gives it
+		const size_t threads = ThreadPool::HardwareThreads();
+		ThreadPool pool(threads);
+		const double concurrent = MeasureMs([&]() {
+			pool.ParallelFor(threads * iterations, [&](size_t, size_t) {
+				ParseOnce(SharedParser::ForThisThread(), source);
+			});
+		});
+
+		std::cout << "  " << threads << " threads, shared tables:    " << concurrent / static_cast<double>(iterations) << " ms per " << threads << " files\n";
+
+		return 0;
+	}
+
+	// What a build pays per shader when it runs one process per file vs. one
+	// process for the whole list. A fresh parser stands in for a fresh process.
+	// Usage: -bench startup [dir]
+	static int BenchStartup(std::vector<std::string> const& args) {
+		const std::filesystem::path dir = args.size() > 1 ? std::filesystem::path(args[1]) : std::filesystem::path("test");
+
+		std::vector<std::string> sources;
+		for (auto& p : std::filesystem::recursive_directory_iterator(dir)) {
+			if (p.is_regular_file() && IsShaderSource(p.path())) {
+				sources.push_back(PrepareSource(p.path()));
+			}
+		}
+		if (sources.empty()) {
+			std::cerr << "startup: no shaders under " << dir.string() << std::endl;
+			return 1;
+		}
+
+		// Time from nothing to the first parsed file, as a new process would see it
+		const double startup = MeasureMs([&]() {
+			SharedParser::Parser parser;
+			ParseOnce(parser, sources.front());
+		});
+
+		const double perProcess = MeasureMs([&]() {
+			for (auto const& source : sources) {
+				SharedParser::Parser parser;
+				ParseOnce(parser, source);
+			}
+		});
+
+		const double batched = MeasureMs([&]() {
+			SharedParser::Parser parser;
+			for (auto const& source : sources) {
+				ParseOnce(parser, source);
+			}
+		});
+
+		const double count = static_cast<double>(sources.size());
+		std::cout << std::fixed << std::setprecision(3)
+			<< "startup: " << sources.size() << " shaders under " << dir.string() << "\n"
+			<< "  startup to first parsed file:    " << startup << " ms\n"
+			<< "  one process per file:            " << perProcess / count << " ms/file\n"
+			<< "  one process for all (-file a b): " << batched / count << " ms/file\n";
+
+		return 0;
+	}
+
+	// The same text formatted with a stringstream, the way ProcessFile formatted bytecode before AppendBytecodeHex
+	static std::string StreamBytecodeHex(std::vector<uint8_t> const& bytecode) {
+		std::stringstream stream;
+		for (size_t i = 0; i < bytecode.size(); ++i) {
+			if (i != 0) {
+				stream << (i % 16 == 0 ? ",\n\t\t\t" : ", ");
+			}
+			stream << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(bytecode[i]);
+		}
+		return stream.str();
+	}
+
+	// Throughput of embedding bytecode as hex, in MB of bytecode per second.
+	// Usage: -bench hex [megabytes] [iterations]
+	static int BenchHex(std::vector<std::string> const& args) {
+		const size_t megabytes = BenchCount(args, 1, 8);
+		const size_t iterations = BenchCount(args, 2, 5);
+
+		// Odd size so a short last line is covered too
+		std::vector<uint8_t> bytecode(megabytes * 1024 * 1024 + 5);
+		uint64_t state = 0x2545f4914f6cdd1dull;
+		for (auto& byte : bytecode) {
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			byte = static_cast<uint8_t>(state >> 56);
+		}
+
+		std::string streamed;
+		const double streamMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				streamed = StreamBytecodeHex(bytecode);
+			}
+		}) / static_cast<double>(iterations);
+
+		// Streams into a sink like generation does; only the hash is kept, so the comparison hashes the baseline
+		uint64_t tableHash = 0;
+		const double tableMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				HashingSink table;
+				AppendBytecodeHex(table, bytecode.data(), bytecode.size());
+				tableHash = table.Digest();
+			}
+		}) / static_cast<double>(iterations);
+
+		if (Hasher::Of(streamed) != tableHash) {
+			std::cerr << "hex: table output differs from the stringstream output" << std::endl;
+			return 1;
+		}
+
+		const double mb = static_cast<double>(bytecode.size()) / (1024.0 * 1024.0);
+		std::cout << std::fixed << std::setprecision(1)
+			<< "hex: " << mb << " MB of bytecode\n"
+			<< "  stringstream: " << mb / (streamMs / 1000.0) << " MB/s\n"
+			<< "  table:        " << mb / (tableMs / 1000.0) << " MB/s\n";
+
+		return 0;
+	}
+
+#ifdef _WIN32
+	static const char* const NullOutput = " > NUL 2>&1";
+#else
+	static const char* const NullOutput = " > /dev/null 2>&1";
+#endif
+
+	// Downstream compile time of a TU including the generated bytecode, for each -bytecode mode.
+	// Compiles with $CXX (c++ if unset) in a temporary directory.
+	// Usage: -bench embed [megabytes]
+	static int BenchEmbed(std::vector<std::string> const& args) {
+		const size_t megabytes = BenchCount(args, 1, 4);
+		const char* cxxEnv = std::getenv("CXX");
+		const std::string cxx = cxxEnv ? cxxEnv : "c++";
+
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "ReflectHLSL-bench-embed";
+		std::filesystem::create_directories(dir);
+
+		std::vector<uint8_t> bytecode(megabytes * 1024 * 1024);
+		uint64_t state = 0x2545f4914f6cdd1dull;
+		for (auto& byte : bytecode) {
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			byte = static_cast<uint8_t>(state >> 56);
+		}
+		const std::filesystem::path spv = dir / "bench.spv";
+		writeFile(spv, std::string_view(reinterpret_cast<const char*>(bytecode.data()), bytecode.size()));
+
+		EmbeddedBytecode embedded;
+		embedded.Data = bytecode.data();
+		embedded.Size = bytecode.size();
+		embedded.EmbedPath = "bench.spv";
+		embedded.IncbinPath = spv.generic_string();
+		embedded.Symbol = "ReflectHLSL_Bytecode_bench";
+
+		auto compile = [&](std::filesystem::path const& source) {
+			std::filesystem::path object = source;
+			object += ".o";
+			const std::string command = cxx + " -std=c++20 -w -c \"" + source.string() + "\" -o \"" + object.string() + "\"" + NullOutput;
+			return std::system(command.c_str()) == 0;
+		};
+
+		const std::filesystem::path probe = dir / "probe.cpp";
+		writeFile(probe, "#if !defined(__has_embed)\n#error no embed\n#endif\n");
+		const bool hasEmbed = compile(probe);
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "embed: " << megabytes << " MB of bytecode, compiled with " << cxx
+			<< (hasEmbed ? " (has #embed)" : " (no #embed, embed mode falls back to incbin)") << "\n";
+
+		const std::pair<const char*, BytecodeMode> modes[] = {
+			{ "hex", BytecodeMode::Hex },
+			{ "embed", BytecodeMode::Embed },
+			{ "incbin", BytecodeMode::Incbin },
+		};
+
+		int result = 0;
+		for (auto const& [name, mode] : modes) {
+			const std::filesystem::path inl = dir / (std::string(name) + ".inl");
+			const std::filesystem::path source = dir / (std::string(name) + ".cpp");
+			const std::filesystem::path assembly = dir / (std::string(name) + ".S");
+
+			FileSink sink(inl);
+			GenerationContext ctx(sink);
+			sink += "#include <cstdint>\n#include <cstddef>\n";
+			GenerateBytecodePrologue(ctx, mode, embedded);
+			sink += "struct Program {";
+			const bool needsAssembly = GenerateBytecode(ctx, mode, embedded);
+			sink += "};\n";
+			sink.Finish();
+
+			writeFile(source, "#include \"" + inl.filename().string() + "\"\nint main() { return Program::Bytecode[Program::BytecodeSize - 1]; }\n");
+			if (needsAssembly) {
+				writeFile(assembly, GenerateBytecodeAssembly(embedded));
+			}
+
+			bool ok = true;
+			const double compileMs = MeasureMs([&]() { ok = compile(source); });
+			const double assembleMs = needsAssembly ? MeasureMs([&]() { ok = ok && compile(assembly); }) : 0.0;
+			if (!ok) {
+				std::cerr << "embed: " << name << " failed to compile" << std::endl;
+				result = 1;
+				continue;
+			}
+
+			std::cout << "  " << std::left << std::setw(7) << name << std::right
+				<< " .inl " << std::setw(9) << static_cast<double>(std::filesystem::file_size(inl)) / 1024.0 << " KB, "
+				<< "compile " << std::setw(8) << compileMs << " ms per including TU";
+			if (needsAssembly) {
+				std::cout << " + " << assembleMs << " ms once for the .S";
+			}
+			std::cout << "\n";
+		}
+
+		return result;
+	}
+
+	// Preprocessing many shaders that include one common header, with the include cache shared by the
+	// whole run vs. a cache per shader, which tokenizes the header again for every shader.
+	// The header is the test shaders' declarations. Usage: -bench preprocess [shaders] [iterations] [dir]
+	static int BenchPreprocess(std::vector<std::string> const& args) {
+		const size_t shaders = BenchCount(args, 1, 200);
+		const size_t iterations = BenchCount(args, 2, 5);
+		const std::filesystem::path dir = args.size() > 3 ? std::filesystem::path(args[3]) : std::filesystem::path("test");
+
+		std::string header = "#ifndef BENCH_COMMON\n#define BENCH_COMMON\n";
+		for (auto& p : std::filesystem::recursive_directory_iterator(dir)) {
+			if (p.is_regular_file() && IsShaderSource(p.path())) {
+				header += MappedFile(p.path()).View();
+				header += "\n";
+			}
+		}
+		header += "#endif\n";
+
+		const std::filesystem::path benchDir = std::filesystem::temp_directory_path() / "ReflectHLSL-bench-preprocess";
+		std::filesystem::create_directories(benchDir);
+		writeFile(benchDir / "common.hlsli", header);
+
+		const std::filesystem::path shaderPath = benchDir / "bench.comp";
+		const std::string shader =
+			"#include \"common.hlsli\"\n"
+			"#include \"common.hlsli\"\n"
+			"RWStructuredBuffer<uint> Out : register(u0);\n";
+
+		// For the headers the test shaders include
+		const std::vector<std::filesystem::path> includeDirs = { dir };
+		const DefinesContext defines;
+		std::string out;
+		auto preprocess = [&](IncludeCache& includes) {
+			out.clear();
+			Preprocessor(includes, includeDirs, defines).Run(shaderPath, shader, out);
+		};
+
+		const double separateMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				for (size_t s = 0; s < shaders; ++s) {
+					IncludeCache includes;
+					preprocess(includes);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		const double sharedMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				IncludeCache includes;
+				for (size_t s = 0; s < shaders; ++s) {
+					preprocess(includes);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "preprocess: " << shaders << " shaders including a " << static_cast<double>(header.size()) / 1024.0 << " KB header, "
+			<< out.size() << " bytes each after expansion\n"
+			<< "  cache per shader: " << separateMs << " ms\n"
+			<< "  shared cache:     " << sharedMs << " ms\n";
+
+		return 0;
+	}
+
+	// Parsing a header with every shader that includes it vs. once, with each shader's own text parsed apart.
+	// Usage: -bench includes [shaders] [iterations] [file]
+	static int BenchIncludes(std::vector<std::string> const& args) {
+		const size_t shaders = BenchCount(args, 1, 200);
+		const size_t iterations = BenchCount(args, 2, 5);
+		const std::string header = PrepareSource(BenchInput(args, 3));
+		const std::string own = "RWStructuredBuffer<uint> Out : register(u0);\n";
+		const std::string whole = header + own;
+
+		auto& parser = SharedParser::ForThisThread();
+		ParseOnce(parser, whole);
+
+		const double wholeMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				for (size_t s = 0; s < shaders; ++s) {
+					ParseOnce(parser, whole);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		const double sharedMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				ParseOnce(parser, header);
+				for (size_t s = 0; s < shaders; ++s) {
+					ParseOnce(parser, own);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "includes: " << shaders << " shaders including a " << static_cast<double>(header.size()) / 1024.0 << " KB header\n"
+			<< "  header parsed per shader: " << wholeMs << " ms\n"
+			<< "  header parsed once:       " << sharedMs << " ms\n";
+
+		return 0;
+	}
+
+	// Two processes of this tool run one after the other without a cache, each on a shader including one header
+	// with different macros defined. Fails unless both shaders' versions of the header are still there afterwards.
+	// Usage: -bench versions
+	static int BenchVersions(std::vector<std::string> const&) {
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "ReflectHLSL-bench-versions";
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+
+		writeFile(dir / "sample.hlsli",
+			"#ifdef WIDE\n"
+			"struct Sample { float4 value; };\n"
+			"#else\n"
+			"struct Sample { float value; };\n"
+			"#endif\n");
+		const char* const shaders[] = { "wide.comp", "narrow.comp" };
+		writeFile(dir / shaders[0], "#define WIDE\n#include \"sample.hlsli\"\nRWStructuredBuffer<Sample> Out : register(u0);\n");
+		writeFile(dir / shaders[1], "#include \"sample.hlsli\"\nRWStructuredBuffer<Sample> Out : register(u0);\n");
+
+		const std::string tool = ExecutablePath(nullptr).string();
+		std::cout << std::fixed << std::setprecision(3) << "versions: " << std::size(shaders) << " processes in sequence, one header\n";
+		for (const char* shader : shaders) {
+			const std::string command = "\"" + tool + "\" -nocache -file \"" + (dir / shader).string() + "\"" + NullOutput;
+			bool ok = false;
+			const double ms = MeasureMs([&]() { ok = std::system(command.c_str()) == 0; });
+			if (!ok) {
+				std::cerr << "versions: " << command << " failed" << std::endl;
+				return 1;
+			}
+			std::cout << "  " << shader << ": " << ms << " ms\n";
+		}
+
+		// Each output names the template of its version and includes the file declaring it
+		int result = 0;
+		std::vector<std::string> symbols;
+		for (const char* shader : shaders) {
+			const MappedFile output(dir / (std::string(shader) + ".inl"));
+			const std::string_view text = output.View();
+			const size_t symbol = text.find("ReflectHLSL_Include_");
+			const size_t include = text.find("#include \"sample.hlsli.");
+			if (symbol == std::string_view::npos || include == std::string_view::npos) {
+				std::cerr << "versions: " << shader << ".inl doesn't derive from the header's declarations" << std::endl;
+				result = 1;
+				continue;
+			}
+
+			const std::string name(text.substr(symbol, text.find('<', symbol) - symbol));
+			const size_t pathBegin = include + std::strlen("#include \"");
+			const std::filesystem::path header = dir / std::string(text.substr(pathBegin, text.find('"', pathBegin) - pathBegin));
+			std::error_code error;
+			const bool declared = std::filesystem::is_regular_file(header, error) &&
+				MappedFile(header).View().find("struct " + name + " {") != std::string_view::npos;
+			if (!declared) {
+				std::cerr << "versions: " << header.filename().string() << ", included by " << shader << ".inl, doesn't declare " << name << std::endl;
+				result = 1;
+			}
+			symbols.push_back(name);
+		}
+
+		if (result == 0 && symbols[0] == symbols[1]) {
+			std::cerr << "versions: both shaders got the same version of the header" << std::endl;
+			result = 1;
+		}
+		std::cout << "  " << (result == 0 ? "both versions survive" : "a version is missing") << "\n";
+		return result;
+	}
+
+	// The text a shader is parsed from keeps its lines where the shader has them, so a parse error on line N is
+	// reported at line N. Each identifier lineN below must come out on line N. Usage: -bench lines
+	static int BenchLines(std::vector<std::string> const&) {
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "ReflectHLSL-bench-lines";
+		std::filesystem::create_directories(dir);
+
+		writeFile(dir / "sample.hlsli",
+			"// The lines of the header count from its first\n"
+			"#define WIDTH 4\n"
+			"struct line3 {\n"
+			"    float line4[WIDTH];\n"
+			"};\n");
+		writeFile(dir / "macros.hlsli", "#pragma once\n#define EMPTY\n#define FIRST(a, b) a\n");
+		const std::filesystem::path shaderPath = dir / "lines.comp";
+		const std::string shader =
+			"#include \"sample.hlsli\"\n"
+			"#include \"macros.hlsli\"\n"
+			"line3 line3;\n"
+			"#if 0\n"
+			"skipped;\n"
+			"#endif\n"
+			"/* a comment\n"
+			"   over two lines */\n"
+			"float line9 = FIRST(1,\n"
+			"    2);\n"
+			"EMPTY int line11;\n"
+			"float line12 = \\\n"
+			"    1;\n"
+			"float line14;\n";
+
+		IncludeCache includes;
+		const std::vector<std::filesystem::path> includeDirs;
+		DefinesContext defines;
+		defines.Define("UNUSED");
+		Preprocessor preprocessor(includes, includeDirs, defines);
+		std::string out;
+		preprocessor.Run(shaderPath, shader, out);
+
+		// Every lineN in text, wherever it is, must be on line N
+		auto check = [](std::string_view name, std::string_view text) {
+			int result = 0;
+			size_t line = 1;
+			for (size_t i = 0; i < text.size(); ++i) {
+				if (text[i] == '\n') {
+					++line;
+				} else if (text.compare(i, 4, "line") == 0 && (i == 0 || !std::isalnum(static_cast<unsigned char>(text[i - 1])))) {
+					const size_t expected = std::strtoul(text.data() + i + 4, nullptr, 10);
+					if (expected != line) {
+						std::cerr << "lines: line" << expected << " is on line " << line << " of " << name << std::endl;
+						result = 1;
+					}
+				}
+			}
+			return result;
+		};
+
+		auto const& regions = preprocessor.Regions();
+		int result = check("the shader parsed by itself", WithoutRegions(out, regions));
+		if (regions.size() != 1) {
+			std::cerr << "lines: expected one header in the output, got " << regions.size() << std::endl;
+			result = 1;
+		} else {
+			result |= check("the header parsed by itself", std::string_view(out).substr(regions[0].Begin, regions[0].End - regions[0].Begin));
+		}
+
+		std::cout << "lines: " << std::count(shader.begin(), shader.end(), '\n') << " shader lines, "
+			<< std::count(out.begin(), out.end(), '\n') << " expanded\n"
+			<< "  " << (result == 0 ? "every line in place" : "lines moved") << "\n";
+		return result;
+	}
+
+	// Heap allocations, arena use and time per parse of a large shader, made by repeating a file.
+	// Usage: -bench ast [file] [repeat] [iterations]
+	static int BenchAst(std::vector<std::string> const& args) {
+		const std::filesystem::path input = BenchInput(args, 1);
+		const size_t repeat = BenchCount(args, 2, 50);
+		const size_t iterations = BenchCount(args, 3, 10);
+
+		const std::string file = PrepareSource(input);
+		std::string source;
+		for (size_t i = 0; i < repeat; ++i) {
+			source += file;
+			source += "\n";
+		}
+
+		auto& parser = SharedParser::ForThisThread();
+		auto& arena = AstArena::ForThisThread();
+		ParseOnce(parser, source);
+
+		size_t nodes = 0;
+		size_t arenaBytes = 0;
+		const size_t allocationsBefore = AllocationsOnThisThread();
+		const double parseMs = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				AstArena::Scope scope;
+				parser.Parse(source);
+				nodes = arena.NodeCount();
+				arenaBytes = arena.BytesUsed();
+			}
+		}) / static_cast<double>(iterations);
+		const size_t allocations = (AllocationsOnThisThread() - allocationsBefore) / iterations;
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "ast: " << input.string() << " x" << repeat << " (" << source.size() << " bytes)\n"
+			<< "  parse:             " << parseMs << " ms\n"
+			<< "  heap allocations:  ";
+		if (AllocationsCounted) std::cout << allocations << " per parse\n";
+		else std::cout << NotCounted;
+		std::cout
+			<< "  arena nodes:       " << nodes << " per parse, " << arenaBytes << " bytes, released in one reset\n"
+			<< "  arena reserved:    " << arena.BytesReserved() << " bytes, kept across files\n";
+
+		return 0;
+	}
+
+	// Parse time of N synthetic top-level declarations for N doubling up to the given count.
+	// Fails if the cost per declaration grows like the list is copied on every reduction.
+	// Usage: -bench scaling [declarations] [iterations]
+	static int BenchScaling(std::vector<std::string> const& args) {
+		const size_t maxDeclarations = BenchCount(args, 1, 10000);
+		const size_t iterations = BenchCount(args, 2, 3);
+
+		auto& parser = SharedParser::ForThisThread();
+
+		std::cout << std::fixed << std::setprecision(3) << "scaling: top-level declarations\n";
+
+		std::vector<double> perDeclaration;
+		for (size_t count = std::max<size_t>(1, maxDeclarations / 8); ; count = std::min(count * 2, maxDeclarations)) {
+			std::string source;
+			for (size_t i = 0; i < count; ++i) {
+				source += "float4 value" + std::to_string(i) + " : register(b" + std::to_string(i % 16) + ");\n";
+			}
+
+			ParseOnce(parser, source);
+			const double ms = MeasureMs([&]() {
+				for (size_t i = 0; i < iterations; ++i) {
+					ParseOnce(parser, source);
+				}
+			}) / static_cast<double>(iterations);
+
+			perDeclaration.push_back(ms * 1000.0 / static_cast<double>(count));
+			std::cout << "  " << std::setw(7) << count << " declarations: " << std::setw(10) << ms << " ms, "
+				<< perDeclaration.back() << " us/declaration\n";
+
+			if (count == maxDeclarations) break;
+		}
+
+		// Linear parsing keeps the cost per declaration flat; quadratic list building would grow it 8x
+		if (perDeclaration.size() > 1 && perDeclaration.front() > 0.0 && perDeclaration.back() > 4.0 * perDeclaration.front()) {
+			std::cerr << "scaling: cost per declaration grew " << perDeclaration.back() / perDeclaration.front() << "x, parsing is not linear" << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	// Counts the generated lines without keeping them, so the sink itself allocates nothing while generating
+	class LineCountingSink : public OutputSink {
+	public:
+		size_t Lines = 0;
+
+	protected:
+		void Drain(const char* data, size_t size) override {
+			Lines += static_cast<size_t>(std::count(data, data + size, '\n'));
+		}
+	};
+
+	// Heap allocations and time per generated line when generating from an already parsed file.
+	// Usage: -bench generate [file] [iterations]
+	static int BenchGenerate(std::vector<std::string> const& args) {
+		const std::filesystem::path input = BenchInput(args, 1);
+		const size_t iterations = BenchCount(args, 2, 1000);
+		const std::string source = PrepareSource(input);
+
+		AstArena::Scope scope;
+		const Program program = SharedParser::ForThisThread().Parse(source);
+
+		size_t lines = 0;
+		size_t allocations = 0;
+		const double ms = MeasureMs([&]() {
+			for (size_t i = 0; i < iterations; ++i) {
+				LineCountingSink sink;
+				GenerationContext ctx(sink);
+				const size_t before = AllocationsOnThisThread();
+				GenerateProgram(ctx, program);
+				sink.Flush();
+				allocations += AllocationsOnThisThread() - before;
+				lines = sink.Lines;
+			}
+		}) / static_cast<double>(iterations);
+
+		const double perRun = static_cast<double>(allocations) / static_cast<double>(iterations);
+		std::cout << std::fixed << std::setprecision(3)
+			<< "generate: " << input.string() << ", " << lines << " lines\n"
+			<< "  time:             " << ms << " ms\n"
+			<< "  heap allocations: ";
+		if (AllocationsCounted) std::cout << perRun << " per file, " << (lines ? perRun / static_cast<double>(lines) : 0.0) << " per line\n";
+		else std::cout << NotCounted;
+
+		return 0;
+	}
+
+	// The benchmark kernels read and write buffers only
+	struct KernelTextureConfig {
+		template<typename T> struct Texture2D { struct Type { }; };
+		template<typename T> struct RWTexture2D { struct Type { }; };
+	};
+
+	using BlendKernel = BlendShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+	using SmoothKernel = SmoothShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+	using TintKernel = TintShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+
+	// test/tint.comp, whose scalars assigned, returned and passed as vectors are converted by the translation,
+	// against the same computation written by hand. Empty if they agree, otherwise what differs.
+	static std::string CheckTint() {
+		const size_t count = 256;
+		const glm::vec3 tint(1.0f, 0.5f, 0.25f);
+		const float amount = 0.25f;
+
+		std::vector<glm::vec3> colors(count), tinted(count);
+		for (size_t i = 0; i < count; ++i) {
+			colors[i] = glm::vec3(static_cast<float>(i % 7), static_cast<float>(i % 5), static_cast<float>(i % 3)) / 6.0f;
+		}
+
+		MappedBuffers buffers;
+		buffers.Bind("Colors", colors.data(), colors.size() * sizeof(glm::vec3));
+		buffers.Bind("Tinted", tinted.data(), tinted.size() * sizeof(glm::vec3));
+		TintKernel kernel(buffers);
+		kernel.ParamsData.tint = tint;
+		kernel.ParamsData.amount = amount;
+		kernel.ParamsData.count = static_cast<uint32_t>(count);
+		TintKernel::GroupShared shared;
+		for (uint32_t group = 0; group < count / 64; ++group) {
+			kernel.RunGroup(group, 0, 0, shared);
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			glm::vec3 color = colors[i];
+			color = glm::mix(color, glm::vec3(glm::dot(color, glm::vec3(0.25f, 0.5f, 0.25f))), 0.5f);
+			color = glm::mix(color, glm::vec3(1.0f), amount) * tint;
+			if (glm::any(glm::greaterThan(glm::abs(tinted[i] - color), glm::vec3(1e-5f)))) {
+				return "element " + std::to_string(i) + " of test/tint.comp differs";
+			}
+		}
+		return { };
+	}
+
+	// The kernel translated with -cpu against the same loop written by hand, run lane by lane on one thread
+	// and spread over every hardware thread with Dispatch.
+	// Usage: -bench cpu [elements] [iterations]
+	static int BenchCpu(std::vector<std::string> const& args) {
+		const size_t count = BenchCount(args, 1, size_t(1) << 22) / 64 * 64;
+		const size_t iterations = BenchCount(args, 2, 20);
+		const uint32_t groups = static_cast<uint32_t>(count / 64);
+		const float amount = 0.25f;
+
+		std::vector<float> x(count);
+		for (size_t i = 0; i < count; ++i) {
+			x[i] = static_cast<float>(i % 1000) / 500.0f - 0.5f;
+		}
+		std::vector<float> reference(count, 1.0f), serial(count, 1.0f), parallel(count, 1.0f);
+
+		const double handWritten = MeasureMs([&]() {
+			for (size_t it = 0; it < iterations; ++it) {
+				for (size_t i = 0; i < count; ++i) {
+					const float v = std::clamp(x[i], 0.0f, 1.0f);
+					reference[i] += (v * v * (3.0f - 2.0f * v) - reference[i]) * amount;
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		auto makeKernel = [&](std::vector<float>& y) {
+			MappedBuffers buffers;
+			buffers.Bind("X", x.data(), x.size() * sizeof(float));
+			buffers.Bind("Y", y.data(), y.size() * sizeof(float));
+			BlendKernel kernel(buffers);
+			kernel.ParamsData.amount = amount;
+			kernel.ParamsData.count = static_cast<uint32_t>(count);
+			return kernel;
+		};
+
+		BlendKernel serialKernel = makeKernel(serial);
+		BlendKernel::GroupShared shared;
+		const double oneThread = MeasureMs([&]() {
+			for (size_t it = 0; it < iterations; ++it) {
+				for (uint32_t group = 0; group < groups; ++group) {
+					serialKernel.RunGroup(group, 0, 0, shared);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		const size_t threads = ThreadPool::HardwareThreads();
+		ThreadPool pool(threads);
+		BlendKernel parallelKernel = makeKernel(parallel);
+		const double dispatched = MeasureMs([&]() {
+			for (size_t it = 0; it < iterations; ++it) {
+				Dispatch(parallelKernel, groups, 1, 1, pool);
+			}
+		}) / static_cast<double>(iterations);
+
+		auto perSecond = [&](double ms) { return ms > 0.0 ? static_cast<double>(count) / ms / 1000.0 : 0.0; };
+		std::cout << std::fixed << std::setprecision(3)
+			<< "cpu: test/blend.comp, " << count << " elements\n"
+			<< "  hand written:     " << handWritten << " ms, " << perSecond(handWritten) << " M elements/s\n"
+			<< "  RunGroup:         " << oneThread << " ms, " << perSecond(oneThread) << " M elements/s\n"
+			<< "  Dispatch:         " << dispatched << " ms, " << perSecond(dispatched) << " M elements/s on " << threads << " threads\n";
+
+		// The translation has to compute what the shader does, not just compile
+		for (size_t i = 0; i < count; ++i) {
+			if (std::abs(serial[i] - reference[i]) > 1e-4f || std::abs(parallel[i] - reference[i]) > 1e-4f) {
+				std::cerr << "cpu: element " << i << " is " << serial[i] << " / " << parallel[i] << ", expected " << reference[i] << std::endl;
+				return 1;
+			}
+		}
+
+		if (const std::string problem = CheckTint(); !problem.empty()) {
+			std::cerr << "cpu: " << problem << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	// Dispatch of test/smooth.comp, a kernel with groupshared memory and a barrier, on 1, 2, 4, ... workers up to
+	// every hardware thread, with the speedup over one worker.
+	// Usage: -bench dispatch [elements] [rounds] [iterations]
+	static int BenchDispatch(std::vector<std::string> const& args) {
+		const size_t count = BenchCount(args, 1, size_t(1) << 20) / 64 * 64;
+		const uint32_t rounds = static_cast<uint32_t>(BenchCount(args, 2, 32));
+		const size_t iterations = BenchCount(args, 3, 10);
+		const uint32_t groups = static_cast<uint32_t>(count / 64);
+
+		std::vector<float> x(count);
+		for (size_t i = 0; i < count; ++i) {
+			x[i] = static_cast<float>(i % 1000) / 1000.0f;
+		}
+
+		// What the kernel computes, neighbours wrapping around within each group of 64
+		std::vector<float> reference(count);
+		for (size_t group = 0; group < count; group += 64) {
+			for (size_t i = 0; i < 64; ++i) {
+				float v = (x[group + (i + 63) % 64] + x[group + i] + x[group + (i + 1) % 64]) / 3.0f;
+				for (uint32_t round = 0; round < rounds; ++round) {
+					v = v * 0.5f + 0.25f * std::sin(v);
+				}
+				reference[group + i] = v;
+			}
+		}
+
+		std::vector<size_t> workerCounts;
+		const size_t hardware = ThreadPool::HardwareThreads();
+		for (size_t workers = 1; workers < hardware; workers *= 2) workerCounts.push_back(workers);
+		workerCounts.push_back(hardware);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "dispatch: test/smooth.comp, " << count << " elements, " << groups << " groups, " << rounds << " rounds\n";
+
+		double single = 0.0;
+		for (size_t workers : workerCounts) {
+			std::vector<float> y(count);
+			MappedBuffers buffers;
+			buffers.Bind("X", x.data(), x.size() * sizeof(float));
+			buffers.Bind("Y", y.data(), y.size() * sizeof(float));
+			SmoothKernel kernel(buffers);
+			kernel.ParamsData.count = static_cast<uint32_t>(count);
+			kernel.ParamsData.rounds = rounds;
+
+			ThreadPool pool(workers);
+			Dispatch(kernel, groups, 1, 1, pool);
+			const double ms = MeasureMs([&]() {
+				for (size_t it = 0; it < iterations; ++it) {
+					Dispatch(kernel, groups, 1, 1, pool);
+				}
+			}) / static_cast<double>(iterations);
+			if (workers == 1) single = ms;
+
+			const double speedup = ms > 0.0 ? single / ms : 0.0;
+			std::cout << "  " << std::setw(3) << workers << " workers: " << std::setw(9) << ms << " ms, "
+				<< speedup << "x, " << speedup / static_cast<double>(workers) * 100.0 << "% efficiency\n";
+
+			for (size_t i = 0; i < count; ++i) {
+				if (std::abs(y[i] - reference[i]) > 1e-4f) {
+					std::cerr << "dispatch: element " << i << " is " << y[i] << " on " << workers << " workers, expected " << reference[i] << std::endl;
+					return 1;
+				}
+			}
+		}
+
+		return 0;
+	}
+
+	// 32 bytes, laid out like a struct generated with a GPU layout
+	struct BenchParticle {
+		float Position[3];
+		float Life;
+		float Velocity[3];
+		uint32_t Flags;
+		static constexpr uint32_t GpuSize = 32;
+	};
+
+	static BenchParticle MakeParticle(size_t i) {
+		const float f = static_cast<float>(i);
+		return { { f, f * 0.5f, -f }, 1.0f, { 0.0f, 1.0f, 0.0f }, static_cast<uint32_t>(i) };
+	}
+
+	// Filling mapped buffer memory in place through a StridedSpan vs. filling a staging copy and copying that
+	// over, as wrappers that stage writes do. The staging vector is kept between runs, so it isn't reallocated.
+	// Usage: -bench views [elements] [iterations]
+	static int BenchViews(std::vector<std::string> const& args) {
+		const size_t count = BenchCount(args, 1, size_t(1) << 20);
+		const size_t iterations = BenchCount(args, 2, 20);
+		const size_t bytes = count * BufferStride<BenchParticle>;
+
+		// Stands in for the mapped memory
+		std::unique_ptr<BenchParticle[]> destination(new BenchParticle[count]);
+		std::unique_ptr<BenchParticle[]> direct(new BenchParticle[count]);
+		std::vector<BenchParticle> staging(count);
+
+		const double staged = MeasureMs([&]() {
+			for (size_t it = 0; it < iterations; ++it) {
+				for (size_t i = 0; i < count; ++i) {
+					staging[i] = MakeParticle(i);
+				}
+				std::memcpy(destination.get(), staging.data(), bytes);
+			}
+		}) / static_cast<double>(iterations);
+
+		const StridedSpan<BenchParticle> view(direct.get(), bytes);
+		const double inPlace = MeasureMs([&]() {
+			for (size_t it = 0; it < iterations; ++it) {
+				for (size_t i = 0; i < count; ++i) {
+					view[i] = MakeParticle(i);
+				}
+			}
+		}) / static_cast<double>(iterations);
+
+		auto mbPerSecond = [&](double ms) { return ms > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0; };
+		std::cout << std::fixed << std::setprecision(3)
+			<< "views: " << count << " elements, " << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MB\n"
+			<< "  staged:   " << staged << " ms, " << mbPerSecond(staged) << " MB/s, " << 2 * bytes / 1024 << " KB written\n"
+			<< "  in place: " << inPlace << " ms, " << mbPerSecond(inPlace) << " MB/s, " << bytes / 1024 << " KB written\n";
+
+		if (std::memcmp(destination.get(), direct.get(), bytes) != 0) {
+			std::cerr << "views: memory filled in place differs from the staged copy" << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	// Structs as cbuffer members, at the offsets the HLSL compiler gives them rather than the generator's own checks.
+	// Ramp would be rearranged by cbuffer packing, so its cbuffer gets no GPU layout instead of a wrong one.
+	using Nested = NestedShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+	static_assert(offsetof(Nested::FogConstants, fog) == 16 && offsetof(Nested::FogConstants, exposure) == 32);
+	static_assert(offsetof(Nested::Fog, density) == 12 && sizeof(Nested::Fog) == 16);
+	template<typename T>
+	constexpr bool HasGpuLayout = requires { T::GpuSize; };
+	static_assert(HasGpuLayout<Nested::FogConstants> && !HasGpuLayout<Nested::RampConstants>);
+
+	// Two shaders in namespaces of their own deriving from one header's .inl, which each namespace gets a copy of
+	using Diffuse = DiffuseShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+	using Specular = SpecularShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+	static_assert(sizeof(Diffuse::LightConstants) == 32 && sizeof(Specular::LightConstants) == 32);
+	static_assert(offsetof(Specular::LightConstants, ambient) == 16 && Specular::Light::GpuSize == 16);
+	static_assert(Diffuse::Bindings.size() == 3 && Diffuse::Bindings[0].Class == ReflectedBinding::ConstantBuffer);
+	static_assert(Specular::Bindings.size() == 4 && Specular::Bindings[1].Class == ReflectedBinding::ConstantBuffer && Specular::Bindings[1].Slot == 1);
+
+	using Scene = SceneShader::Generator<GLMVectorConfig, MappedBufferConfig, KernelTextureConfig, MappedBuffers>::Program;
+
+	// A frame that moves the camera, changes one light of the cbuffer and edits elements of a buffer of lights
+	// 1 in 100 elements, uploaded whole vs. through the dirty tracking of -dirty.
+	// Usage: -bench dirty [frames] [elements]
+	static int BenchDirty(std::vector<std::string> const& args) {
+		const size_t frames = BenchCount(args, 1, 1000);
+		const size_t count = std::max<size_t>(BenchCount(args, 2, 4096), 1);
+		const size_t edits = std::max<size_t>(count / 100, 1);
+
+		Scene::SceneConstantBufferTracked constants;
+		TrackedElements<Scene::LightState> lights(count);
+		constants.Dirty.MarkAll(sizeof(constants.Data));
+
+		// Stand in for the mapped cbuffer and buffer
+		std::vector<std::byte> wholeConstants(sizeof(Scene::SceneConstantBuffer)), trackedConstants(sizeof(Scene::SceneConstantBuffer));
+		std::vector<std::byte> wholeLights(count * sizeof(Scene::LightState)), trackedLights(count * sizeof(Scene::LightState));
+
+		auto update = [&](size_t frame) {
+			float floats[16] = { };
+			for (size_t i = 0; i < 16; ++i) floats[i] = static_cast<float>(frame + i);
+			decltype(Scene::SceneConstantBuffer::view) view;
+			std::memcpy(&view, floats, sizeof(view));
+			constants.set_view(view);
+
+			Scene::LightState light = constants.Data.lights[frame % 16];
+			std::memcpy(&light.color, floats, sizeof(light.color));
+			constants.set_lights(frame % 16, light);
+
+			for (size_t i = 0; i < edits; ++i) {
+				const size_t index = (frame * 7919 + i * 104729) % count;
+				std::memcpy(&lights.Edit(index).position, floats, sizeof(light.position));
+			}
+		};
+
+		size_t wholeBytes = 0;
+		const double whole = MeasureMs([&]() {
+			for (size_t frame = 0; frame < frames; ++frame) {
+				update(frame);
+				std::memcpy(wholeConstants.data(), &constants.Data, wholeConstants.size());
+				std::memcpy(wholeLights.data(), lights.Data(), wholeLights.size());
+				wholeBytes += wholeConstants.size() + wholeLights.size();
+			}
+		}) / static_cast<double>(frames);
+
+		// The same frames again, uploading what they changed
+		constants.Dirty.MarkAll(sizeof(constants.Data));
+		lights.Resize(count);
+		size_t trackedBytes = 0;
+		const double tracked = MeasureMs([&]() {
+			for (size_t frame = 0; frame < frames; ++frame) {
+				update(frame);
+				trackedBytes += constants.FlushTo(trackedConstants.data());
+				trackedBytes += lights.FlushTo(trackedLights.data());
+			}
+		}) / static_cast<double>(frames);
+
+		const double perFrame = static_cast<double>(frames);
+		std::cout << std::fixed << std::setprecision(3)
+			<< "dirty: test/scene.comp, " << frames << " frames, " << count << " lights, " << edits << " edited per frame\n"
+			<< "  whole:   " << std::setw(10) << static_cast<double>(wholeBytes) / perFrame << " bytes per frame, " << whole << " ms\n"
+			<< "  tracked: " << std::setw(10) << static_cast<double>(trackedBytes) / perFrame << " bytes per frame, " << tracked << " ms\n";
+
+		// What was uploaded bit by bit has to add up to the CPU copy
+		if (std::memcmp(trackedConstants.data(), &constants.Data, trackedConstants.size()) != 0 ||
+			std::memcmp(trackedLights.data(), lights.Data(), trackedLights.size()) != 0) {
+			std::cerr << "dirty: the uploaded bytes differ from the CPU copy" << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	struct Benchmark {
+		const char* Name;
+		int (*Run)(std::vector<std::string> const& args);
+	};
+
+	static const Benchmark Benchmarks[] = {
+		{ "parser", BenchParser },
+		{ "startup", BenchStartup },
+		{ "hex", BenchHex },
+		{ "embed", BenchEmbed },
+		{ "preprocess", BenchPreprocess },
+		{ "includes", BenchIncludes },
+		{ "versions", BenchVersions },
+		{ "lines", BenchLines },
+		{ "ast", BenchAst },
+		{ "scaling", BenchScaling },
+		{ "generate", BenchGenerate },
+		{ "cpu", BenchCpu },
+		{ "dispatch", BenchDispatch },
+		{ "views", BenchViews },
+		{ "dirty", BenchDirty },
+	};
+
+	int RunBenchmarks(std::vector<std::string> const& args) {
+		int result = 0;
+		bool found = false;
+
+		for (auto const& bench : Benchmarks) {
+			if (!args.empty() && args[0] != bench.Name) continue;
+			found = true;
+
+			try {
+				result |= bench.Run(args.empty() ? std::vector<std::string>{ bench.Name } : args);
+			}
+			catch (std::exception const& ex) {
+				std::cerr << bench.Name << ": " << ex.what() << std::endl;
+				result = 1;
+			}
+		}
+
+		if (!found) {
+			std::cerr << "Unknown benchmark " << args[0] << ", expected one of:";
+			for (auto const& bench : Benchmarks) {
+				std::cerr << " " << bench.Name;
+			}
+			std::cerr << std::endl;
+			return 1;
+		}
+
+		return result;
+	}
+}
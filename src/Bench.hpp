@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ReflectHLSL {
+	// Runs the benchmark named by args[0] (all of them if args is empty) and prints the results
+	int RunBenchmarks(std::vector<std::string> const& args);
+}
@@ -0,0 +1,349 @@
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iomanip>
+
+#include "Cache.hpp"
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/file.h>
+#endif
+
+namespace ReflectHLSL {
+    static const char* const CacheHeader = "ReflectHLSL-cache 1";
+
+    static std::string AbsoluteName(std::filesystem::path const& path) {
+        return std::filesystem::absolute(path).lexically_normal().generic_string();
+    }
+
+    std::string BuildCache::EntryName(std::filesystem::path const& input) {
+        return AbsoluteName(input);
+    }
+
+    // A temporary file next to path, unique to this call, so processes saving the same cache at once
+    // never write into each other's file before it is renamed over path
+    static std::filesystem::path TempPath(std::filesystem::path const& path) {
+        static std::atomic<uint64_t> calls = 0;
+        const uint64_t unique = Hasher()
+            .Update(std::to_string(std::random_device()()))
+            .Update(std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))
+            .Update(std::to_string(++calls))
+            .Digest();
+
+        std::ostringstream name;
+        name << "." << std::hex << std::setw(16) << std::setfill('0') << unique << ".tmp";
+        std::filesystem::path temp = path;
+        temp += name.str();
+        return temp;
+    }
+
+    // Holds an exclusive lock on <path>.lock while it lives, so processes saving the same cache take turns
+    // reading, merging and replacing it. The system drops the lock if the process dies holding it.
+    class FileLock {
+    public:
+        explicit FileLock(std::filesystem::path const& path) {
+            std::filesystem::path lockPath = path;
+            lockPath += ".lock";
+#ifdef _WIN32
+            Handle = CreateFileW(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (Handle == INVALID_HANDLE_VALUE) return;
+            OVERLAPPED overlapped = { };
+            if (!LockFileEx(Handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) {
+                CloseHandle(Handle);
+                Handle = INVALID_HANDLE_VALUE;
+            }
+#else
+            Fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (Fd < 0) return;
+            while (flock(Fd, LOCK_EX) != 0) {
+                if (errno != EINTR) {
+                    close(Fd);
+                    Fd = -1;
+                    return;
+                }
+            }
+#endif
+        }
+
+        ~FileLock() {
+#ifdef _WIN32
+            if (Handle != INVALID_HANDLE_VALUE) CloseHandle(Handle);
+#else
+            if (Fd >= 0) close(Fd);
+#endif
+        }
+
+        FileLock(FileLock const&) = delete;
+        FileLock& operator=(FileLock const&) = delete;
+
+    private:
+#ifdef _WIN32
+        HANDLE Handle = INVALID_HANDLE_VALUE;
+#else
+        int Fd = -1;
+#endif
+    };
+
+    void BuildCache::Read(std::filesystem::path const& path, std::map<std::string, Entry>& entries) {
+        std::ifstream file(path);
+        std::string line;
+        if (!std::getline(file, line) || line != CacheHeader) return;
+
+        // <key> <output hash> <output size> <input path>
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            Entry entry;
+            fields >> std::hex >> entry.Key >> entry.OutputHash >> std::dec >> entry.OutputSize;
+            fields.get();
+
+            std::string name;
+            std::getline(fields, name);
+            if (!fields.fail() && !name.empty()) {
+                entries[name] = entry;
+            }
+        }
+    }
+
+    void BuildCache::Load(std::filesystem::path path) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Path = path;
+        Entries.clear();
+        Recorded.clear();
+        Read(path, Entries);
+    }
+
+    void BuildCache::Save() const {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (Recorded.empty() || Path.empty()) return;
+
+        // Another process may have saved since Load; its entries stay unless this one recorded newer ones
+        const FileLock fileLock(Path);
+        std::map<std::string, Entry> entries;
+        Read(Path, entries);
+        for (auto const& name : Recorded) {
+            entries[name] = Entries.at(name);
+        }
+
+        // Write next to the cache and swap it in, so an interrupted run can't leave half a cache behind
+        const std::filesystem::path temp = TempPath(Path);
+        std::error_code ec;
+        {
+            std::ofstream file(temp, std::ios::trunc);
+            file << CacheHeader << "\n";
+            for (auto const& [name, entry] : entries) {
+                file << std::hex << std::setw(16) << std::setfill('0') << entry.Key << " "
+                    << std::setw(16) << entry.OutputHash << " "
+                    << std::dec << entry.OutputSize << " " << name << "\n";
+            }
+            file.close();
+            if (!file) {
+                std::filesystem::remove(temp, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(temp, Path, ec);
+        if (ec) std::filesystem::remove(temp, ec);
+    }
+
+    bool BuildCache::UpToDate(std::filesystem::path const& input, uint64_t key, std::filesystem::path const& output) const {
+        if (!Enabled()) return false;
+
+        Entry entry;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            auto it = Entries.find(EntryName(input));
+            if (it == Entries.end()) return false;
+            entry = it->second;
+        }
+        if (entry.Key != key) return false;
+
+        // Catches deleted and hand edited outputs. The size rules most of them out before the output is read.
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(output, ec);
+        if (ec || size != entry.OutputSize) return false;
+
+        try {
+            const MappedFile contents(output);
+            return Hasher().Update(contents.Bytes(), contents.Length()).Digest() == entry.OutputHash;
+        }
+        catch (std::exception const&) {
+            return false;
+        }
+    }
+
+    void BuildCache::Record(std::filesystem::path const& input, uint64_t key, uint64_t outputHash, uint64_t outputSize) {
+        if (!Enabled()) return;
+
+        Entry entry;
+        entry.Key = key;
+        entry.OutputHash = outputHash;
+        entry.OutputSize = outputSize;
+
+        const std::string name = EntryName(input);
+        std::lock_guard<std::mutex> lock(Mutex);
+        Entries[name] = entry;
+        Recorded.insert(name);
+    }
+
+    static const char* const IncludeCacheHeader = "ReflectHLSL-includes 3";
+
+    void IncludeDeclarationCache::Read(std::filesystem::path const& path, std::map<std::string, Header>& headers) {
+        std::ifstream file(path, std::ios::binary);
+        std::string line;
+        if (!std::getline(file, line) || line != IncludeCacheHeader) return;
+
+        // header <source> <path>, then its versions:
+        // version <key> <type count> <text size>, a line of <size> <alignment> <cbuffer size> <cbuffer alignment> <name>
+        // per type, the text and a newline
+        Header* header = nullptr;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+
+            if (kind == "header") {
+                uint64_t source = 0;
+                fields >> std::hex >> source;
+                fields.get();
+
+                std::string name;
+                std::getline(fields, name);
+                if (fields.fail() || name.empty()) return;
+
+                header = &headers[name];
+                header->Source = source;
+            } else if (kind == "version" && header) {
+                uint64_t key = 0;
+                size_t types = 0;
+                size_t size = 0;
+                fields >> std::hex >> key >> std::dec >> types >> size;
+                if (fields.fail()) return;
+
+                auto declarations = std::make_shared<Declarations>();
+                declarations->Source = header->Source;
+                declarations->Types.resize(types);
+                for (auto& type : declarations->Types) {
+                    if (!std::getline(file, line)) return;
+                    std::istringstream typeFields(line);
+                    typeFields >> type.Layout.Size >> type.Layout.Alignment >> type.CBufferLayout.Size >> type.CBufferLayout.Alignment;
+                    typeFields.get();
+                    std::getline(typeFields, type.Name);
+                    if (typeFields.fail() || type.Name.empty()) return;
+                }
+                declarations->Text.resize(size);
+                if (!file.read(declarations->Text.data(), static_cast<std::streamsize>(size)) || file.get() != '\n') return;
+
+                header->Versions[key] = std::move(declarations);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void IncludeDeclarationCache::Load(std::filesystem::path path) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Path = path;
+        Headers.clear();
+        Read(path, Headers);
+    }
+
+    void IncludeDeclarationCache::Save() const {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (Path.empty()) return;
+        const bool changed = std::any_of(Headers.begin(), Headers.end(), [](auto const& entry) { return entry.second.Changed; });
+        if (!changed) return;
+
+        // Like BuildCache::Save, merged into what other processes saved since Load: the headers this one
+        // changed get its source, and its versions next to theirs
+        const FileLock fileLock(Path);
+        std::map<std::string, Header> headers;
+        Read(Path, headers);
+        for (auto const& [name, ours] : Headers) {
+            if (!ours.Changed) continue;
+            Header& merged = headers[name];
+            merged.Source = ours.Source;
+            for (auto const& [key, declarations] : ours.Versions) {
+                merged.Versions[key] = declarations;
+            }
+        }
+
+        const std::filesystem::path temp = TempPath(Path);
+        std::error_code ec;
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            file << IncludeCacheHeader << "\n";
+            for (auto const& [name, header] : headers) {
+                file << "header " << std::hex << std::setw(16) << std::setfill('0') << header.Source << std::dec << " " << name << "\n";
+                for (auto const& [key, declarations] : header.Versions) {
+                    if (declarations->Source != header.Source) continue;
+
+                    file << "version " << std::hex << std::setw(16) << key << std::dec << " "
+                        << declarations->Types.size() << " " << declarations->Text.size() << "\n";
+                    for (auto const& type : declarations->Types) {
+                        file << type.Layout.Size << " " << type.Layout.Alignment << " "
+                            << type.CBufferLayout.Size << " " << type.CBufferLayout.Alignment << " " << type.Name << "\n";
+                    }
+                    file << declarations->Text << "\n";
+                }
+            }
+            file.close();
+            if (!file) {
+                std::filesystem::remove(temp, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(temp, Path, ec);
+        if (ec) std::filesystem::remove(temp, ec);
+    }
+
+    std::shared_ptr<IncludeDeclarationCache::Declarations const> IncludeDeclarationCache::Find(std::filesystem::path const& header, uint64_t key, uint64_t source) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Header& entry = Headers[AbsoluteName(header)];
+        entry.Used = true;
+        if (entry.Source != source) {
+            entry.Source = source;
+            entry.Changed = true;
+        }
+
+        auto it = entry.Versions.find(key);
+        if (it == entry.Versions.end() || it->second->Source != source) return nullptr;
+        return it->second;
+    }
+
+    void IncludeDeclarationCache::Insert(std::filesystem::path const& header, uint64_t key, std::shared_ptr<Declarations const> declarations) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Header& entry = Headers[AbsoluteName(header)];
+        entry.Versions[key] = std::move(declarations);
+        entry.Changed = true;
+    }
+
+    std::vector<std::filesystem::path> IncludeDeclarationCache::TakeUsedHeaders() {
+        std::lock_guard<std::mutex> lock(Mutex);
+        std::vector<std::filesystem::path> used;
+        for (auto& [name, header] : Headers) {
+            if (!header.Used) continue;
+            header.Used = false;
+            used.push_back(name);
+        }
+        return used;
+    }
+
+    std::vector<IncludeDeclarationCache::Version> IncludeDeclarationCache::Versions(std::filesystem::path const& header) const {
+        std::lock_guard<std::mutex> lock(Mutex);
+        std::vector<Version> versions;
+        auto it = Headers.find(AbsoluteName(header));
+        if (it == Headers.end()) return versions;
+
+        for (auto const& [key, declarations] : it->second.Versions) {
+            if (declarations->Source == it->second.Source) versions.emplace_back(key, declarations);
+        }
+        return versions;
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <filesystem>
+
+#include "Layout.hpp"
+
+namespace ReflectHLSL {
+    // Streaming 64 bit hash, 8 bytes per step. Not cryptographic, only used to
+    // tell whether inputs changed since the last run.
+    class Hasher {
+    public:
+        inline Hasher& Update(const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            Length += size;
+
+            while (size > 0) {
+                const size_t take = std::min<size_t>(size, 8 - Pending);
+                std::memcpy(Buffer + Pending, bytes, take);
+                Pending += take;
+                bytes += take;
+                size -= take;
+
+                if (Pending == 8) {
+                    uint64_t word;
+                    std::memcpy(&word, Buffer, 8);
+                    Mix(word);
+                    Pending = 0;
+                }
+            }
+
+            return *this;
+        }
+
+        inline Hasher& Update(std::string_view text) {
+            // Length prefix so that ("ab", "c") and ("a", "bc") hash differently
+            const uint64_t size = text.size();
+            Update(&size, sizeof(size));
+            return Update(text.data(), text.size());
+        }
+
+        inline uint64_t Digest() const {
+            Hasher copy = *this;
+            uint64_t tail = 0;
+            std::memcpy(&tail, copy.Buffer, copy.Pending);
+            copy.Mix(tail ^ (static_cast<uint64_t>(copy.Length) << 56));
+            return Finalize(copy.State ^ copy.Length);
+        }
+
+        static inline uint64_t Of(std::string_view text) {
+            return Hasher().Update(text.data(), text.size()).Digest();
+        }
+
+    private:
+        static inline uint64_t Finalize(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        inline void Mix(uint64_t word) {
+            word *= 0x87c37b91114253d5ull;
+            word = (word << 31) | (word >> 33);
+            word *= 0x4cf5ad432745937full;
+            State ^= word;
+            State = ((State << 27) | (State >> 37)) * 5 + 0x52dce729;
+        }
+
+        uint64_t State = 0x9e3779b97f4a7c15ull;
+        uint64_t Length = 0;
+        uint8_t Buffer[8] = { };
+        size_t Pending = 0;
+    };
+
+    // Remembers, per input file, the hash of everything its output was
+    // generated from. Replaces the mtime comparison, which is unreliable after
+    // git checkouts, CI cache restores and on network filesystems.
+    // Safe to query and update from several threads.
+    class BuildCache {
+    public:
+        // Read a cache written by Save. A missing or unreadable file is an empty cache.
+        void Load(std::filesystem::path path);
+
+        // Write back the entries recorded since Load, merged into the file as it is now, so processes
+        // running at the same time keep each other's entries
+        void Save() const;
+
+        bool Enabled() const { return !Path.empty(); }
+
+        // True if output was generated from exactly this key and still hashes the same as what we wrote
+        bool UpToDate(std::filesystem::path const& input, uint64_t key, std::filesystem::path const& output) const;
+
+        // outputHash and outputSize describe the generated text, as an OutputSink reports them
+        void Record(std::filesystem::path const& input, uint64_t key, uint64_t outputHash, uint64_t outputSize);
+
+    private:
+        struct Entry {
+            uint64_t Key = 0;
+            uint64_t OutputHash = 0;
+            uint64_t OutputSize = 0;
+        };
+
+        static std::string EntryName(std::filesystem::path const& input);
+        static void Read(std::filesystem::path const& path, std::map<std::string, Entry>& entries);
+
+        std::filesystem::path Path;
+        std::map<std::string, Entry> Entries;
+        // Names of the entries recorded since Load
+        std::set<std::string> Recorded;
+        mutable std::mutex Mutex;
+    };
+
+    // Generated declarations of the headers shaders #include, so a header shared by many shaders is
+    // parsed once, not once per shader. A header has a version per key, the hash of its expansion,
+    // which covers the macros defined where it was included. Kept across runs in a file of its own.
+    // Safe to query and update from several threads.
+    class IncludeDeclarationCache {
+    public:
+        struct Declarations {
+            // Hash of the header's source, with the files it includes
+            uint64_t Source = 0;
+            // Structs and cbuffers it declares at the top level
+            std::vector<DeclaredType> Types;
+            // Members and constructor of its Program, as GenerateProgram writes them
+            std::string Text;
+        };
+
+        using Version = std::pair<uint64_t, std::shared_ptr<Declarations const>>;
+
+        // Read a file written by Save. A missing or unreadable file is an empty cache.
+        void Load(std::filesystem::path path);
+
+        // Write back the headers changed since Load, merged into the file as it is now like BuildCache::Save.
+        // Versions are only kept if they were generated from their header's current source.
+        void Save() const;
+
+        // The version, or null if it has not been generated. Also marks source as the header's current source.
+        std::shared_ptr<Declarations const> Find(std::filesystem::path const& header, uint64_t key, uint64_t source);
+
+        void Insert(std::filesystem::path const& header, uint64_t key, std::shared_ptr<Declarations const> declarations);
+
+        // Headers looked up since the last call, which clears the list
+        std::vector<std::filesystem::path> TakeUsedHeaders();
+
+        // Versions of header generated from its current source, in key order
+        std::vector<Version> Versions(std::filesystem::path const& header) const;
+
+    private:
+        struct Header {
+            uint64_t Source = 0;
+            bool Used = false;
+            // Its source or versions changed since Load
+            bool Changed = false;
+            std::map<uint64_t, std::shared_ptr<Declarations const>> Versions;
+        };
+
+        static void Read(std::filesystem::path const& path, std::map<std::string, Header>& headers);
+
+        std::filesystem::path Path;
+        // By absolute path, like BuildCache
+        std::map<std::string, Header> Headers;
+        mutable std::mutex Mutex;
+    };
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+namespace ReflectHLSL {
+    // The pool Dispatch runs on when given none, one thread per hardware thread, started on first use
+    inline ThreadPool& DispatchPool() {
+        static ThreadPool pool(ThreadPool::HardwareThreads());
+        return pool;
+    }
+
+    // Runs the compute kernel of a Program generated with -cpu over groupsX * groupsY * groupsZ workgroups,
+    // spread over pool, and returns once all of them ran. Workgroups go out in contiguous runs, a few per
+    // worker so stealing evens out uneven ones, since taking a task from the pool costs a lock.
+    //
+    // Each worker has its own GroupShared, the scratch of the group it is running, allocated once per
+    // Dispatch and reused for every group, so running a group allocates nothing. They are cache line
+    // aligned, so workers writing their groupshared memory don't share lines.
+    //
+    // Dispatches from several threads onto one pool run one after the other, not interleaved. A kernel
+    // may Dispatch onto the pool running it; that nested Dispatch runs inline on the calling worker.
+    template<typename Program>
+    void Dispatch(Program& program, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, ThreadPool& pool) {
+        const size_t groups = size_t(groupsX) * groupsY * groupsZ;
+        if (groups == 0) return;
+
+        struct alignas(64) Scratch {
+            typename Program::GroupShared Shared;
+        };
+        std::vector<Scratch> scratch(pool.Size());
+
+        constexpr size_t TasksPerWorker = 4;
+        const size_t tasks = std::min(groups, pool.Size() * TasksPerWorker);
+
+        pool.ParallelFor(tasks, [&](size_t task, size_t worker) {
+            typename Program::GroupShared& shared = scratch[worker].Shared;
+            const size_t end = groups * (task + 1) / tasks;
+            for (size_t group = groups * task / tasks; group < end; ++group) {
+                program.RunGroup(
+                    static_cast<uint32_t>(group % groupsX),
+                    static_cast<uint32_t>(group / groupsX % groupsY),
+                    static_cast<uint32_t>(group / groupsX / groupsY),
+                    shared);
+            }
+        });
+    }
+
+    // Dispatch on DispatchPool()
+    template<typename Program>
+    void Dispatch(Program& program, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+        Dispatch(program, groupsX, groupsY, groupsZ, DispatchPool());
+    }
+}
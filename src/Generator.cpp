@@ -1,78 +1,261 @@
+#include <array>
+
 #include "Generator.hpp"
 
 namespace ReflectHLSL {
-	void DefinesContext::ReplaceDefine(std::string& inout) const {
-		const std::string from = "#define";
-		const std::string to = "#undef";
-		size_t start_pos = 0;
-		while ((start_pos = inout.find(from, start_pos)) != std::string::npos) {
-			inout.replace(start_pos, from.length(), to);
-			start_pos += to.length(); // Handles case where 'to' is a substring of 'from'
+	static constexpr auto HexPairs = []() {
+		std::array<char, 512> table = { };
+		const char digits[] = "0123456789abcdef";
+		for (size_t i = 0; i < 256; ++i) {
+			table[i * 2] = digits[i >> 4];
+			table[i * 2 + 1] = digits[i & 15];
+		}
+		return table;
+	}();
+
+	void AppendBytecodeHex(OutputSink& out, const uint8_t* bytecode, size_t size) {
+		constexpr size_t BytesPerLine = 16;
+		const char lineBreak[] = ",\n\t\t\t";
+		constexpr size_t LineBreakChars = 5;	// ",\n\t\t\t" ahead of every line but the first
+		constexpr size_t ByteChars = 6;			// 0xab, the last of a line without the comma and space
+
+		for (size_t line = 0; line < size; line += BytesPerLine) {
+			const size_t count = std::min(BytesPerLine, size - line);
+			char* const start = out.Reserve(LineBreakChars + count * ByteChars);
+			char* dst = start;
+
+			if (line != 0) {
+				std::memcpy(dst, lineBreak, LineBreakChars);
+				dst += LineBreakChars;
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				if (i != 0) {
+					*dst++ = ',';
+					*dst++ = ' ';
+				}
+				*dst++ = '0';
+				*dst++ = 'x';
+				std::memcpy(dst, &HexPairs[bytecode[line + i] * 2], 2);
+				dst += 2;
+			}
+
+			out.Commit(static_cast<size_t>(dst - start));
+		}
+	}
+
+	std::string GenerationOptions::Fingerprint() const {
+		return "bytecode=" + std::to_string(static_cast<int>(Bytecode)) + " layout=" + std::to_string(static_cast<int>(StructLayout)) +
+			" soa=" + std::to_string(StructOfArrays) + " dirty=" + std::to_string(DirtyTracking) + " cpu=" + std::to_string(CpuKernels);
+	}
+
+	static bool UsesSymbol(BytecodeMode mode, EmbeddedBytecode const& bytecode) {
+		return mode != BytecodeMode::Hex && bytecode.Size != 0;
+	}
+
+	void GenerateBytecodePrologue(GenerationContext& ctx, BytecodeMode mode, EmbeddedBytecode const& bytecode) {
+		if (!UsesSymbol(mode, bytecode)) return;
+
+		OutputSink& out = ctx.Output;
+		if (mode == BytecodeMode::Embed) out += "#if !defined(__has_embed)\n";
+		out += "extern \"C\" const uint8_t ";
+		out += bytecode.Symbol;
+		out += '[';
+		out += std::to_string(bytecode.Size);
+		out += "];\n";
+		if (mode == BytecodeMode::Embed) out += "#endif\n";
+	}
+
+	bool GenerateBytecode(GenerationContext& ctx, BytecodeMode mode, EmbeddedBytecode const& bytecode) {
+		OutputSink& out = ctx.Output;
+		const std::string size = std::to_string(bytecode.Size);
+		out += "\n\t\tstatic constexpr size_t BytecodeSize = ";
+		out += size;
+		out += ';';
+
+		if (!UsesSymbol(mode, bytecode)) {
+			out += "\n\t\tstatic constexpr uint8_t Bytecode[] = {\n\t\t\t";
+			AppendBytecodeHex(out, bytecode.Data, bytecode.Size);
+			out += "\n\t\t};\n";
+			return false;
+		}
+
+		// A reference keeps Bytecode usable like the array: sizeof, indexing, decay to a pointer
+		auto reference = [&]() {
+			out += "\t\tstatic constexpr const uint8_t (&Bytecode)[";
+			out += size;
+			out += "] = ";
+			out += bytecode.Symbol;
+			out += ";\n";
+		};
+
+		if (mode == BytecodeMode::Incbin) {
+			out += '\n';
+			reference();
+			return true;
 		}
+
+		out += "\n#if defined(__has_embed)\n"
+			"\t\tstatic constexpr uint8_t Bytecode[] = {\n"
+			"#embed \"";
+		out += bytecode.EmbedPath;
+		out += "\"\n"
+			"\t\t};\n"
+			"#else\n";
+		reference();
+		out += "#endif\n";
+		return true;
 	}
-	std::string DefinesContext::GetDefs() const {
-		std::string res;
-		for (std::string str : Defines) {
-			if (str.find("#define") == std::string::npos) continue;
-			res += str + "\n";
+
+	std::string GenerateBytecodeAssembly(EmbeddedBytecode const& bytecode) {
+		return
+			"// Defines " + bytecode.Symbol + " for compilers without #embed. Assemble it and link it in.\n"
+			"#if defined(__APPLE__)\n"
+			"#define BYTECODE_SYMBOL _" + bytecode.Symbol + "\n"
+			"\t.const_data\n"
+			"#else\n"
+			"#define BYTECODE_SYMBOL " + bytecode.Symbol + "\n"
+			"\t.section .rodata\n"
+			"#endif\n"
+			"\t.globl BYTECODE_SYMBOL\n"
+			"\t.balign 8\n"
+			"BYTECODE_SYMBOL:\n"
+			"\t.incbin \"" + bytecode.IncbinPath + "\"\n"
+			"#if defined(__ELF__)\n"
+			"\t.section .note.GNU-stack,\"\",%progbits\n"
+			"#endif\n";
+	}
+
+	// Types of the Members tables of generated structs, the Bindings tables of Programs, the storage of -soa mirrors
+	// and the change tracking of -dirty. They live in one header at global scope, so generated files included in
+	// namespaces of their own all refer to the same ones.
+	static constexpr std::string_view RuntimeInclude =
+		"// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first\n"
+		"#include \"ReflectHLSLRuntime.hpp\"\n"
+		"\n";
+
+	static constexpr std::string_view TemplateParameters =
+		"template<\n"
+		"	typename VectorConfig,\n"
+		"	typename BufferConfig,\n"
+		"	typename TextureConfig,\n"
+		"	typename Context\n"
+		">\n";
+
+	static constexpr std::string_view TypeAliases =
+		"	using float1 = float;\n"
+		"	using float2 = typename VectorConfig::template Vector<2, float>::Type;\n"
+		"	using float3 = typename VectorConfig::template Vector<3, float>::Type;\n"
+		"	using float4 = typename VectorConfig::template Vector<4, float>::Type;\n"
+		"	using int1 = int32_t;\n"
+		"	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;\n"
+		"	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;\n"
+		"	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;\n"
+		"	using uint = uint32_t;\n"
+		"	using uint1 = uint32_t;\n"
+		"	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;\n"
+		"	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;\n"
+		"	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;\n"
+		"	using double1 = double;\n"
+		"	using double2 = typename VectorConfig::template Vector<2, double>::Type;\n"
+		"	using double3 = typename VectorConfig::template Vector<3, double>::Type;\n"
+		"	using double4 = typename VectorConfig::template Vector<4, double>::Type;\n"
+		"	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;\n"
+		"\n"
+		"	using ReflectedMember = ::ReflectHLSL::ReflectedMember;\n"
+		"	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;\n"
+		"	using DirtyRanges = ::ReflectHLSL::DirtyRanges;\n"
+		"\n"
+		"	template<typename... Columns>\n"
+		"	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;\n"
+		"\n"
+		"	template<typename T>\n"
+		"	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;\n"
+		"\n"
+		"	template<typename T>\n"
+		"	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;\n"
+		"\n"
+		"	template<typename T>\n"
+		"	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;\n"
+		"\n"
+		"	template<typename T>\n"
+		"	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;\n"
+		"\n"
+		"	template<typename T>\n"
+		"	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;\n";
+
+	void GenerateHeader(GenerationContext& ctx) {
+		OutputSink& out = ctx.Output;
+		for (auto const& include : ctx.Includes) {
+			out += "#include \"";
+			out += include.InlPath;
+			out += "\"\n";
+		}
+
+		out += RuntimeInclude;
+		out += TemplateParameters;
+		out += "struct Generator {\n";
+		out += TypeAliases;
+		out += '\n';
+
+		if (ctx.Includes.empty()) {
+			out += "	struct Program {\n";
+			return;
+		}
+
+		for (size_t i = 0; i < ctx.Includes.size(); ++i) {
+			out += "	using Include";
+			out += std::to_string(i);
+			out += " = typename ";
+			out += ctx.Includes[i].Symbol;
+			out += "<VectorConfig, BufferConfig, TextureConfig, Context>::Program;\n";
+		}
+		out += '\n';
+
+		out += "	struct Program";
+		for (size_t i = 0; i < ctx.Includes.size(); ++i) {
+			out += i == 0 ? " : Include" : ", Include";
+			out += std::to_string(i);
+		}
+		out += " {\n";
+
+		// The bases are dependent, so their types aren't found by plain lookup
+		for (size_t i = 0; i < ctx.Includes.size(); ++i) {
+			for (auto const& type : ctx.Includes[i].Types) {
+				out += "\t\tusing typename Include";
+				out += std::to_string(i);
+				out += "::";
+				out += type.Name;
+				out += ";\n";
+			}
 		}
-		return res;
 	}
-	std::string DefinesContext::GetUndefs() const {
-		std::string res;
-		for (std::string str : Defines) {
-			if (str.find("#define") == std::string::npos) continue;
-			ReplaceDefine(str);
-			res += str + "\n";
+
+	void GenerateIncludeFile(OutputSink& out, std::string_view description, std::vector<IncludeVersion> const& versions) {
+		out += "// ";
+		out += description;
+		// No #pragma once: each shader namespace including it needs its own copy of the templates
+		out += "\n\n";
+		out += RuntimeInclude;
+
+		for (size_t i = 0; i < versions.size(); ++i) {
+			IncludeVersion const& version = versions[i];
+			if (i != 0) out += '\n';
+			out += TemplateParameters;
+			out += "struct ";
+			out += version.Symbol;
+			out += " {\n";
+			out += TypeAliases;
+			out += "\n"
+				"	struct Program {\n";
+			out += version.Program;
+			out += "	};\n"
+				"};\n";
 		}
-		return res;
 	}
-	std::string Generate(GenerationContext const& ctx, DefinesContext const& dctx) {
-		const std::string part0 =
-			"template<\n"
-			"	typename VectorConfig,\n"
-			"	typename BufferConfig,\n"
-			"	typename TextureConfig,\n"
-			"	typename Context\n"
-			">\n"
-			"struct Generator {\n"
-			"	using float1 = float;\n"
-			"	using float2 = VectorConfig::template Vector<2, float>::typename Type;\n"
-			"	using float3 = VectorConfig::template Vector<3, float>::typename Type;\n"
-			"	using float4 = VectorConfig::template Vector<4, float>::typename Type;\n"
-			"	using int1 = int32_t;\n"
-			"	using int2 = VectorConfig::template Vector<2, int32_t>::typename Type;\n"
-			"	using int3 = VectorConfig::template Vector<3, int32_t>::typename Type;\n"
-			"	using int4 = VectorConfig::template Vector<4, int32_t>::typename Type;\n"
-			"	using uint = uint32_t;\n"
-			"	using uint1 = uint32_t;\n"
-			"	using uint2 = VectorConfig::template Vector<2, uint32_t>::typename Type;\n"
-			"	using uint3 = VectorConfig::template Vector<3, uint32_t>::typename Type;\n"
-			"	using uint4 = VectorConfig::template Vector<4, uint32_t>::typename Type;\n"
-			"	using double1 = double;\n"
-			"	using double2 = VectorConfig::template Vector<2, double>::typename Type;\n"
-			"	using double3 = VectorConfig::template Vector<3, double>::typename Type;\n"
-			"	using double4 = VectorConfig::template Vector<4, double>::typename Type;\n"
-			"	using float4x4 = VectorConfig::template Matrix<4, float>::typename Type;\n"
-			"\n"
-			"	template<typename T>\n"
-			"	using StructuredBuffer = BufferConfig::template Buffer<T>::typename Type;\n"
-			"\n"
-			"	template<typename T>\n"
-			"	using RWStructuredBuffer = BufferConfig::template RWBuffer<T>::typename Type;\n"
-			"\n"
-			"	template<typename T>\n"
-			"	using Texture2D = TextureConfig::template Texture2D<T>::typename Type;\n"
-			"\n"
-			"	template<typename T>\n"
-			"	using RWTexture2D = TextureConfig::template RWTexture2D<T>::typename Type;\n"
-			"\n"
-			"	struct Program {\n";
-
-		return part0 +
-			dctx.GetDefs() +
-			ctx.Output +
-			dctx.GetUndefs() +
+
+	void GenerateFooter(GenerationContext& ctx) {
+		ctx.Output +=
 			"	};\n"
 			"};\n";
 	}
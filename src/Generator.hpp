@@ -3,73 +3,70 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
 #include <format>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <type_traits>
 
 #include <glm/glm.hpp>
 
-static void writeFile(std::filesystem::path path, std::string text) {
-	std::ofstream file(path);
-	file << text;
-}
-
-static std::string loadFile(std::filesystem::path path) {
-	std::ifstream t(path);
-	return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-}
-
-static std::vector<uint8_t> loadFileBytes(std::filesystem::path path) {
-	std::ifstream t(path, std::ios::binary);
-	return std::vector<uint8_t>((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-}
+#include "Layout.hpp"
+#include "OutputSink.hpp"
 
 namespace ReflectHLSL {
-	struct DefinesContext {
-		std::vector<std::string> Defines;
-
-		void ReplaceDefine(std::string& inout) const;
-
-		std::string GetDefs() const;
-
-		std::string GetUndefs() const;
-	};
-
-
-	struct TestProgram {
-		// Begin Generated Section
-		
-		//constexpr static ProgramDeclaration Program = {
-		//	StructDeclaration { "struct", "BlahType", { "", "" }, {
-		//		VarDeclaration { "", "vec4", "", "abc",		{ false, "" }, { "", "" }, false, { true, "0.0", { }}},
-		//		VarDeclaration { "", "vec2", "", "uv",		{ false, "" }, { "", "" }, false, { true, "0.0", { }}},
-		//		VarDeclaration { "", "float", "", "field",	{ false, "" }, { "", "" }, false, { true, "0.0", { }}},
-		//		VarDeclaration { "", "int", "", "val",		{ false, "" }, { "", "" }, false, { true, "0",   { }}}
-		//	} },
-		//	VarDeclaration { "", "StructuredBuffer", "", "MyBlahs", { false, "" }, { "", "" }, false, { true, "0.0", { }}}
-		//};
-		
-		constexpr static uint8_t Bytecode[3427] = { 0 };
-		
-		//struct BlahType {
-		//	vec4 abc;
-		//	vec2 uv;
-		//	float field;
-		//	int val;
-		//};
-
-		//struct Dispatch {
-		//	StructuredBuffer<BlahType> MyBlahs;
-		//};
-		//
-		// End Generated Section
-	};
-	
 	struct GLMVectorConfig {
 		template<int L,			typename T> struct Vector { using Type = glm::vec<L,    T>;	};
 		template<int C, int R,	typename T> struct Matrix { using Type = glm::mat<C, R, T>;	};
+
+		// HLSL intrinsics, which the CPU versions of shader functions call through the VectorConfig
+		static auto abs(auto const& x)											{ return glm::abs(x); }
+		static auto acos(auto const& x)											{ return glm::acos(x); }
+		static auto asin(auto const& x)											{ return glm::asin(x); }
+		static auto atan(auto const& x)											{ return glm::atan(x); }
+		static auto atan2(auto const& y, auto const& x)							{ return glm::atan(y, x); }
+		static auto ceil(auto const& x)											{ return glm::ceil(x); }
+		static auto clamp(auto const& x, auto const& low, auto const& high)		{ return glm::clamp(x, low, high); }
+		static auto cos(auto const& x)											{ return glm::cos(x); }
+		static auto cross(auto const& a, auto const& b)							{ return glm::cross(a, b); }
+		static auto distance(auto const& a, auto const& b)						{ return glm::distance(a, b); }
+		static auto dot(auto const& a, auto const& b)							{ return glm::dot(a, b); }
+		static auto exp(auto const& x)											{ return glm::exp(x); }
+		static auto exp2(auto const& x)											{ return glm::exp2(x); }
+		static auto floor(auto const& x)										{ return glm::floor(x); }
+		static auto frac(auto const& x)											{ return glm::fract(x); }
+		static auto length(auto const& x)										{ return glm::length(x); }
+		static auto lerp(auto const& a, auto const& b, auto const& t)			{ return glm::mix(a, b, t); }
+		static auto log(auto const& x)											{ return glm::log(x); }
+		static auto log2(auto const& x)											{ return glm::log2(x); }
+		static auto mad(auto const& a, auto const& b, auto const& c)			{ return a * b + c; }
+		static auto max(auto const& a, auto const& b)							{ return glm::max(a, b); }
+		static auto min(auto const& a, auto const& b)							{ return glm::min(a, b); }
+		static auto normalize(auto const& x)									{ return glm::normalize(x); }
+		static auto pow(auto const& x, auto const& y)							{ return glm::pow(x, y); }
+		static auto reflect(auto const& i, auto const& n)						{ return glm::reflect(i, n); }
+		static auto round(auto const& x)										{ return glm::round(x); }
+		static auto rsqrt(auto const& x)										{ return glm::inversesqrt(x); }
+		static auto sign(auto const& x)											{ return glm::sign(x); }
+		static auto sin(auto const& x)											{ return glm::sin(x); }
+		static auto smoothstep(auto const& low, auto const& high, auto const& x){ return glm::smoothstep(low, high, x); }
+		static auto sqrt(auto const& x)											{ return glm::sqrt(x); }
+		static auto step(auto const& edge, auto const& x)						{ return glm::step(edge, x); }
+		static auto tan(auto const& x)											{ return glm::tan(x); }
+		static auto trunc(auto const& x)										{ return glm::trunc(x); }
+
+		// The matrices hold HLSL's columns as glm columns, so mul(m, v) is m * v and mul(v, m), v as a row, is v * m
+		static auto mul(auto const& a, auto const& b)							{ return a * b; }
+
+		static auto saturate(auto const& x) {
+			using T = std::remove_cvref_t<decltype(x)>;
+			return glm::clamp(x, T(0), T(1));
+		}
 	};
 
 	struct BufferConfig {
@@ -77,12 +74,115 @@ namespace ReflectHLSL {
 		template<typename T> struct RWBuffer { struct Type {}; };
 	};
 
+	// A header whose declarations are generated once into <header>.inl and shared by every shader including it
+	struct SharedInclude {
+		std::string InlPath;				// The .inl of this version as the shader's .inl includes it
+		std::string Symbol;					// Template in it holding this version of the declarations
+		std::vector<DeclaredType> Types;	// Structs it declares, which Program names without qualification
+	};
+
+	// A cbuffer or resource's register(...) resolved to numbers, like register(t1, space2)
+	struct ResourceBinding {
+		enum class RegisterClass : uint8_t {
+			ConstantBuffer,		// b
+			ShaderResource,		// t
+			UnorderedAccess,	// u
+			Sampler,			// s
+		};
+
+		std::string Name;
+		RegisterClass Class = RegisterClass::ShaderResource;
+		uint32_t Slot = 0;
+		uint32_t Space = 0;
+		std::string Count = "1";	// Descriptors it takes, as a C++ expression since array sizes may be macros
+	};
+
 	struct GenerationContext {
-		std::map<std::string, std::string> CBufferRegisterMap;
-		std::map<std::string, std::string> VarRegisterMap;
+		explicit GenerationContext(OutputSink& output) : Output(output) { }
+
+		// Explicit registers of the Program's cbuffers and resources, in declaration order
+		std::vector<ResourceBinding> Bindings;
+
+		// Program derives from the Program of each, in include order
+		std::vector<SharedInclude> Includes;
+
+		// Layout of structs other than cbuffers, and the layouts of the structs generated so far by name and the
+		// rules of the block they are members of: their own, or CBuffer if a cbuffer places their members alike
+		LayoutRules StructLayout = LayoutRules::Std430;
+		std::map<std::pair<std::string, LayoutRules>, TypeLayout> StructLayouts;
+
+		// Follow each top-level struct with a GPU layout by a structure of arrays mirroring it
+		bool StructOfArrays = false;
+
+		// Follow each top-level struct and cbuffer with a GPU layout by a copy with setters tracking changes
+		bool DirtyTracking = false;
+
+		// Translate the functions into members running on the CPU, reading their bodies from Source,
+		// the text the Program was parsed from
+		bool CpuKernels = false;
+		std::string_view Source;
+
+		// Generated text is streamed here in file order
+		OutputSink& Output;
+	};
+
+	// How the .spv ends up in the generated Bytecode member
+	enum class BytecodeMode {
+		Hex,	// Initializer list of hex bytes in the .inl
+		Embed,	// #embed where the compiler supports it, otherwise Incbin
+		Incbin,	// Assembly file next to the .spv that .incbin's it, referenced by symbol
+	};
+
+	// Options that change the generated text. Part of the cache key.
+	struct GenerationOptions {
+		BytecodeMode Bytecode = BytecodeMode::Hex;
+		LayoutRules StructLayout = LayoutRules::Std430;
+		bool StructOfArrays = false;
+		bool DirtyTracking = false;
+		bool CpuKernels = false;
+
+		std::string Fingerprint() const;
+	};
+
+	struct EmbeddedBytecode {
+		const uint8_t* Data = nullptr;
+		size_t Size = 0;
+		std::string EmbedPath;	// The .spv as #embed sees it, relative to the .inl
+		std::string IncbinPath;	// The .spv as the assembler sees it
+		std::string Symbol;		// Linker symbol defined by the assembly
+	};
+
+	// Appends bytecode as comma separated 0x%02x bytes, sixteen per line, so it initializes a uint8_t array
+	// without narrowing. Table driven and formatted straight into the sink's buffer, no stream formatting.
+	void AppendBytecodeHex(OutputSink& out, const uint8_t* bytecode, size_t size);
+
+	// A generated file is, in order: GenerateBytecodePrologue, GenerateHeader, the Program
+	// members (GenerateProgram in MetaData.hpp), GenerateBytecode, GenerateFooter.
+
+	// Declarations the bytecode needs at namespace scope, ahead of the Generator template
+	void GenerateBytecodePrologue(GenerationContext& ctx, BytecodeMode mode, EmbeddedBytecode const& bytecode);
+
+	// Opens the Generator template and its Program struct, deriving from ctx.Includes
+	void GenerateHeader(GenerationContext& ctx);
+
+	// Emits BytecodeSize and Bytecode in the given mode. Empty bytecode is always emitted as hex.
+	// Returns whether the assembly from GenerateBytecodeAssembly is needed to link.
+	bool GenerateBytecode(GenerationContext& ctx, BytecodeMode mode, EmbeddedBytecode const& bytecode);
+
+	// Closes what GenerateHeader opened
+	void GenerateFooter(GenerationContext& ctx);
+
+	// Preprocessed assembly (.S) defining bytecode.Symbol with the contents of bytecode.IncbinPath
+	std::string GenerateBytecodeAssembly(EmbeddedBytecode const& bytecode);
 
-		std::string Output;
+	// One version of a shared header: its template name and the Program body GenerateProgram wrote for it
+	struct IncludeVersion {
+		std::string Symbol;
+		std::string_view Program;
 	};
 
-	std::string Generate(GenerationContext const& ctx, DefinesContext const& dctx);
+	// A file of shared declarations, like <header>.<version key>.inl: a comment saying what they are, then a template
+	// per version with the same parameters and type names as Generator. Unguarded, so every shader .inl including it
+	// declares the templates in its own namespace.
+	void GenerateIncludeFile(OutputSink& out, std::string_view description, std::vector<IncludeVersion> const& versions);
 }
\ No newline at end of file
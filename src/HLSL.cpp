@@ -1,78 +1,213 @@
 #include <cmath>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
 #include <array>
+#include <bit>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
 
 #include "HLSL.hpp"
+#include "Tool.hpp"
+#include "Bench.hpp"
+#include "ThreadPool.hpp"
+#include "Cache.hpp"
+#include "MappedFile.hpp"
+#include "Preprocessor.hpp"
 
-static std::filesystem::file_time_type lastWriteTime;
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
 
-// Replace comments with spaces
-std::string removeComments(std::string input) {
-    std::string res = input;
-    bool inCommentLine = false;
-    bool inCommentBlock = false;
+#ifndef REFLECTHLSL_VERSION
+#define REFLECTHLSL_VERSION "dev"
+#endif
 
-    auto check = [&](size_t i, char c) {return i < input.size() && input[i] == c; };
+// Hash of the tool itself, so a new build of it regenerates everything
+static uint64_t toolFingerprint = 0;
+static ReflectHLSL::BuildCache buildCache;
+static ReflectHLSL::GenerationOptions generationOptions;
 
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (check(i, '/')) {
-            if (check(i + 1, '/')) {
-                inCommentLine = true;
-            }
+// -I directories and -D macros, and the headers read so far in this run
+static std::vector<std::filesystem::path> includeDirs;
+static ReflectHLSL::DefinesContext predefinedMacros;
+static ReflectHLSL::IncludeCache includeCache;
 
-            if (!inCommentLine && check(i + 1, '*')) {
-                inCommentBlock = true;
-            }
-        }
+// Generated declarations of included headers, by header and version
+static ReflectHLSL::IncludeDeclarationCache includeDeclarations;
 
-        if (inCommentBlock && i >= 2 && check(i - 2, '*') && check(i - 1, '/')) {
-            inCommentBlock = false;
-        }
-        if (check(i, '\n')) {
-            inCommentLine = false;
-        }
+// What happened to each output, reported after a multi-file run with -verbose
+static bool verboseOutput = false;
+static std::atomic<size_t> outputsWritten = 0;
+static std::atomic<size_t> outputsUnchanged = 0;
+static std::atomic<size_t> outputsUpToDate = 0;
 
-        if (inCommentLine || inCommentBlock) {
-            res[i] = ' ';
-        }
+// Unique per .spv, and a valid identifier: ReflectHLSL_Bytecode_<file name>_<hash of the full path>
+static std::string BytecodeSymbol(std::filesystem::path const& spvPath) {
+    std::string symbol = "ReflectHLSL_Bytecode_";
+    for (char c : spvPath.filename().string()) {
+        symbol.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
     }
 
-    return res;
+    const uint64_t hash = ReflectHLSL::Hasher::Of(spvPath.generic_string());
+    char suffix[18];
+    std::snprintf(suffix, sizeof(suffix), "_%08x", static_cast<uint32_t>(hash));
+    return symbol + suffix;
 }
 
-std::string removeDefines(ReflectHLSL::DefinesContext& ctx, std::string input) {
-    std::string res = input;
-    std::string currentMacro;
-    bool inMacroLine = false;
-    bool escapingNewline = false;
-
-    auto check = [&](int i, char c) { return i >= 0 && i < static_cast<int>(input.size()) && input[i] == c; };
-
-    for (int i = 0; i < static_cast<int>(input.size()); ++i) {
-        if (check(i, '#')) {
-            inMacroLine = true;
-        } else if (!escapingNewline && check(i, '\\')) {
-            escapingNewline = true;
-        } else if (!escapingNewline && check(i, '\n')) {
-            if (inMacroLine) {
-                ctx.Defines.push_back(currentMacro);
-                currentMacro.clear();
-            }
-            inMacroLine = false;
-        } else {
-            escapingNewline = false;
+// Unique per header version, and a valid identifier: ReflectHLSL_Include_<file name>_<version key>
+static std::string IncludeSymbol(std::filesystem::path const& header, uint64_t key) {
+    std::string symbol = "ReflectHLSL_Include_";
+    for (char c : header.filename().string()) {
+        symbol.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+
+    char suffix[18];
+    std::snprintf(suffix, sizeof(suffix), "_%016llx", static_cast<unsigned long long>(key));
+    return symbol + suffix;
+}
+
+// <header>.<version key>.inl. A file per version, so a run that only sees some versions of a header never
+// drops the others, which outputs of earlier runs or of other processes still include.
+static std::filesystem::path IncludeOutput(std::filesystem::path const& header, uint64_t key) {
+    char suffix[22];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx.inl", static_cast<unsigned long long>(key));
+    std::filesystem::path output = header;
+    output += suffix;
+    return output;
+}
+
+static bool IsBlank(std::string_view text) {
+    return text.find_first_not_of(" \t\r\n") == std::string_view::npos;
+}
+
+struct IncludedHeader {
+    ReflectHLSL::Preprocessor::IncludedRegion const* Region = nullptr;
+    uint64_t Key = 0;
+    // Null until generated
+    std::shared_ptr<ReflectHLSL::IncludeDeclarationCache::Declarations const> Declarations;
+};
+
+// Parses the whole expanded source s. Lines after an #include are moved down by the header's, so when it doesn't parse
+// and the shader's own text doesn't either, the error of the latter is thrown, at the line the shader has it on.
+static ReflectHLSL::Program ParseWhole(ReflectHLSL::SharedParser::Handle& parse, std::string const& s,
+    std::vector<ReflectHLSL::Preprocessor::IncludedRegion> const& regions)
+{
+    try {
+        return parse.Parse(s);
+    }
+    catch (parsegen::parse_error const&) {
+        if (regions.empty()) throw;
+        const std::string own = ReflectHLSL::WithoutRegions(s, regions);
+        if (!IsBlank(own)) parse.Parse(own);
+        throw;
+    }
+}
+
+// Parses the shader's own text, and the headers whose declarations aren't generated yet, each on its own.
+// Fills includes with the headers for the output at output. Throws if any of them doesn't parse by itself.
+static ReflectHLSL::Program ParseApart(ReflectHLSL::SharedParser::Handle& parse, std::string const& s,
+    std::vector<ReflectHLSL::Preprocessor::IncludedRegion> const& regions, std::vector<IncludedHeader>& headers, std::filesystem::path const& output, std::vector<ReflectHLSL::SharedInclude>& includes)
+{
+    std::vector<IncludedHeader*> generated;
+    for (auto& header : headers) {
+        ReflectHLSL::Preprocessor::IncludedRegion const& region = *header.Region;
+        if (!header.Declarations) {
+            const std::string text = s.substr(region.Begin, region.End - region.Begin);
+
+            ReflectHLSL::Program declarations;
+            if (!IsBlank(text)) declarations = parse.Parse(text);
+
+            ReflectHLSL::StringSink sink;
+            ReflectHLSL::GenerationContext ctx(sink);
+            ctx.StructLayout = generationOptions.StructLayout;
+            ctx.StructOfArrays = generationOptions.StructOfArrays;
+            ctx.DirtyTracking = generationOptions.DirtyTracking;
+            ReflectHLSL::GenerateProgram(ctx, declarations);
+
+            header.Declarations = std::make_shared<ReflectHLSL::IncludeDeclarationCache::Declarations const>(
+                ReflectHLSL::IncludeDeclarationCache::Declarations { region.SourceHash, ReflectHLSL::DeclaredTypes(ctx, declarations), sink.Text() });
+            generated.push_back(&header);
         }
 
-        if (inMacroLine) {
-            currentMacro.push_back(res[i]);
-            res[i] = ' ';
+        const std::filesystem::path inl = std::filesystem::absolute(IncludeOutput(region.Path, header.Key)).lexically_normal();
+        includes.push_back({
+            std::filesystem::relative(inl, std::filesystem::absolute(output).parent_path()).generic_string(),
+            IncludeSymbol(region.Path, header.Key),
+            header.Declarations->Types
+        });
+    }
+    // Its lines keep their numbers, so errors in it point at the right line of the shader
+    const std::string own = ReflectHLSL::WithoutRegions(s, regions);
+
+    ReflectHLSL::Program p;
+    if (!IsBlank(own)) p = parse.Parse(own);
+
+    // Only once everything parsed, so a failed split leaves nothing behind
+    for (IncludedHeader* header : generated) {
+        includeDeclarations.Insert(header->Region->Path, header->Key, header->Declarations);
+    }
+    return p;
+}
+
+// Generates output from p, parsed from source or part of it, with the bytecode of spvPath embedded, and records it in the build cache under
+// cacheEntry. Lists what it wrote to out.
+static void GenerateOutput(std::filesystem::path const& cacheEntry, uint64_t cacheKey, std::filesystem::path const& output,
+    std::filesystem::path const& spvPath, ReflectHLSL::MappedFile const& bytecode, ReflectHLSL::Program const& p,
+    std::string_view source, std::vector<ReflectHLSL::SharedInclude> includes, std::ostream& out)
+{
+    // Embed the bytecode from the .spv file
+    ReflectHLSL::EmbeddedBytecode embedded;
+    embedded.Data = bytecode.Bytes();
+    embedded.Size = bytecode.Length();
+    if (generationOptions.Bytecode != ReflectHLSL::BytecodeMode::Hex) {
+        const std::filesystem::path absoluteSpv = std::filesystem::absolute(spvPath).lexically_normal();
+        embedded.EmbedPath = std::filesystem::relative(absoluteSpv, std::filesystem::absolute(output).parent_path()).generic_string();
+        embedded.IncbinPath = absoluteSpv.generic_string();
+        embedded.Symbol = BytecodeSymbol(absoluteSpv);
+    }
+
+    // Generated text streams into the output as it is produced, never held whole in memory
+    ReflectHLSL::FileSink sink(output);
+    ReflectHLSL::GenerationContext ctx(sink);
+    ctx.Includes = std::move(includes);
+    ctx.StructLayout = generationOptions.StructLayout;
+    ctx.StructOfArrays = generationOptions.StructOfArrays;
+    ctx.DirtyTracking = generationOptions.DirtyTracking;
+    ctx.CpuKernels = generationOptions.CpuKernels;
+    ctx.Source = source;
+
+    ReflectHLSL::GenerateBytecodePrologue(ctx, generationOptions.Bytecode, embedded);
+    ReflectHLSL::GenerateHeader(ctx);
+    ReflectHLSL::GenerateProgram(ctx, p);
+    const bool needsAssembly = ReflectHLSL::GenerateBytecode(ctx, generationOptions.Bytecode, embedded);
+    ReflectHLSL::GenerateFooter(ctx);
+
+    const uint64_t outputHash = sink.Digest();
+    if (sink.Finish()) {
+        ++outputsWritten;
+        out << output.string() << std::endl;
+    } else {
+        ++outputsUnchanged;
+    }
+
+    if (needsAssembly) {
+        std::filesystem::path assemblyPath = spvPath;
+        assemblyPath += ".S";
+        if (writeFile(assemblyPath, ReflectHLSL::GenerateBytecodeAssembly(embedded))) {
+            out << assemblyPath.string() << std::endl;
         }
     }
 
-    return res;
+    buildCache.Record(cacheEntry, cacheKey, outputHash, sink.Size());
 }
 
-int ProcessFile(std::filesystem::path input, std::filesystem::path output = "") {
+int ProcessFile(std::filesystem::path input, std::ostream& out, std::ostream& err, std::filesystem::path output) {
     if (output.empty()) {
         output = input;
         output += ".inl";
@@ -81,209 +216,895 @@ int ProcessFile(std::filesystem::path input, std::filesystem::path output = "")
     std::filesystem::path spvPath = input;
     spvPath += ".spv";
 
-    // Early return if file is not out of date
-    if (std::filesystem::exists(output)) {
-        auto inputTime = std::filesystem::last_write_time(input);
-        auto outputTime = std::filesystem::last_write_time(output);
+    try {
+        auto& parse = ReflectHLSL::SharedParser::ForThisThread();
 
-        if (inputTime < outputTime && lastWriteTime < outputTime) {
-            return 0;
+        // The expanded source, the only copy; the buffer keeps its capacity for the next file on this thread
+        thread_local std::string s;
+        s.clear();
+        std::vector<ReflectHLSL::Preprocessor::IncludedRegion> regions;
+        {
+            const ReflectHLSL::MappedFile source(input);
+            ReflectHLSL::Preprocessor preprocessor(includeCache, includeDirs, predefinedMacros);
+            preprocessor.Run(input, source.View(), s);
+            regions = preprocessor.Regions();
         }
-    }
 
-    try {
-        parsegen::Parser<ReflectHLSL::HLSL> parse;
+        // Each header the shader includes is a version keyed by its path and expansion, which covers the
+        // macros defined where it was included. Generated versions are shared with every other shader.
+        std::vector<IncludedHeader> headers;
+        bool allHeadersGenerated = true;
+        for (auto const& region : regions) {
+            const std::string_view text = std::string_view(s).substr(region.Begin, region.End - region.Begin);
+            IncludedHeader header;
+            header.Region = &region;
+            header.Key = ReflectHLSL::Hasher()
+                .Update(region.Path.generic_string())
+                .Update(generationOptions.Fingerprint())
+                .Update(text)
+                .Digest();
+            header.Declarations = includeDeclarations.Find(region.Path, header.Key, region.SourceHash);
+            allHeadersGenerated = allHeadersGenerated && header.Declarations;
+            headers.push_back(std::move(header));
+        }
 
-        ReflectHLSL::DefinesContext dctx;
+        ReflectHLSL::MappedFile bytecode;
+        if (std::filesystem::exists(spvPath)) {
+            bytecode = ReflectHLSL::MappedFile(spvPath);
+        }
 
-        std::string s = loadFile(input);
-        s = removeDefines(dctx, s);
-        s = removeComments(s);
-        ReflectHLSL::Program p = parse.Parse(s);
+        // Early return if the output was generated from exactly these inputs. Hashing the expanded
+        // source covers included headers and -D macros, and ignores edits to comments that keep their lines.
+        const uint64_t cacheKey = ReflectHLSL::Hasher()
+            .Update(&toolFingerprint, sizeof(toolFingerprint))
+            .Update(output.generic_string())
+            .Update(generationOptions.Fingerprint())
+            .Update(s)
+            .Update(bytecode.View())
+            .Digest();
 
-        ReflectHLSL::GenerationContext ctx;
+        // The output includes the .inl of each of its headers' versions, written only for versions in the cache
+        if (allHeadersGenerated && buildCache.UpToDate(input, cacheKey, output)) {
+            ++outputsUpToDate;
+            return 0;
+        }
 
+        // Everything the parse allocates is released at once when this goes out of scope, after the AST
+        ReflectHLSL::AstArena::Scope arenaScope;
 
-        std::string currentInvokeSize;
-        std::vector<ReflectHLSL::VarDecl> structuredVariables;
+        ReflectHLSL::Program p;
+        std::vector<ReflectHLSL::SharedInclude> includes;
+        // CPU versions of the functions call what the headers define, so they need everything in one Program
+        if (headers.empty() || generationOptions.CpuKernels) {
+            p = ParseWhole(parse, s, regions);
+        } else {
+            try {
+                p = ParseApart(parse, s, regions, headers, output, includes);
+            }
+            catch (parsegen::parse_error const&) {
+                // A header that doesn't parse apart from the shader, like one included inside a struct, is reflected inline
+                includes.clear();
+                p = ParseWhole(parse, s, regions);
+            }
+        }
 
-        for (auto d : p.Val.Val) {
-            if (d.index() == 0) {
-                ReflectHLSL::VarDecl v = std::get<ReflectHLSL::VarDecl>(d);
-                v.GetGeneration(ctx, 2);
+        GenerateOutput(input, cacheKey, output, spvPath, bytecode, p, s, std::move(includes), out);
 
-                if (v.GetTypename() == "StructuredBuffer" ||
-                    v.GetTypename() == "RWStructuredBuffer")
-                {
-                    structuredVariables.push_back(v);
-                }
-            }
-            else if (d.index() == 1) {
-                const ReflectHLSL::FDecl func = std::get<ReflectHLSL::FDecl>(d);
+        return 0;
+    }
+    catch (parsegen::parse_error const& ex) {
+        err << ex.what() << std::endl;
+        return 1;
+    }
+    catch (std::exception const& ex) {
+        err << ex.what() << std::endl;
+        return 1;
+    }
+}
 
-                const std::string returnType = func.returnType.Val;
-                const std::string name = func.name.Val;
+bool IsShaderSource(std::filesystem::path const& path) {
+    const std::string extension = path.extension().string();
+    return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
 
-                ctx.Output += "\n\t\t// " + returnType;
+bool IsShaderInclude(std::filesystem::path const& path) {
+    const std::string extension = path.extension().string();
+    return extension == ".hlsli" || extension == ".hlsl" || extension == ".fxh" || extension == ".h";
+}
 
-                // Output all the parameter types
-                for (auto param : func.params) {
-                    ctx.Output += "\n\t\t// - " + param.typeName.Val + " " + param.name.Val;
-                }
+void SaveBuildCache() {
+    buildCache.Save();
+    includeDeclarations.Save();
+}
 
-                if (!name.empty() && !currentInvokeSize.empty()) {
-                    ctx.Output += "\n\t\tstatic constexpr uint3 " /*+ name +*/ "InvokeSize = " + currentInvokeSize;
-                    currentInvokeSize.clear();
+// Writes <header>.<version key>.inl for every version of the current source of each header included since the last call
+static int WriteIncludeDeclarations(std::ostream& out, std::ostream& err) {
+    int anyError = 0;
+    for (auto const& header : includeDeclarations.TakeUsedHeaders()) {
+        for (auto const& [key, declarations] : includeDeclarations.Versions(header)) {
+            const std::filesystem::path inl = IncludeOutput(header, key);
+            try {
+                ReflectHLSL::FileSink sink(inl);
+                ReflectHLSL::GenerateIncludeFile(sink, "Declarations of " + header.filename().string() +
+                    " shared by the shaders including it with the same macros defined", { { IncludeSymbol(header, key), declarations->Text } });
+                if (sink.Finish()) {
+                    out << inl.string() << std::endl;
                 }
             }
-            else if (d.index() == 2) {
-                currentInvokeSize = "uint3(" +
-                    std::get<ReflectHLSL::FunctionAttrib>(d).literals[0]->format() + ", " +
-                    std::get<ReflectHLSL::FunctionAttrib>(d).literals[1]->format() + ", " +
-                    std::get<ReflectHLSL::FunctionAttrib>(d).literals[2]->format() + ");\n";
+            catch (std::exception const& ex) {
+                err << ex.what() << std::endl;
+                err << "Failed to write " << inl.string() << std::endl;
+                anyError = 1;
             }
         }
+    }
+    return anyError;
+}
 
-        ctx.Output += "\n\t\tinline Program(Context& ctx)\n";
-        for (size_t i = 0; i < structuredVariables.size(); ++i) {
-            if (i == 0) {
-                ctx.Output += "\t\t: ";
-            }
-            else {
-                ctx.Output += "\t\t, ";
-            }
+static void ReportOutputs(size_t files, size_t written, size_t unchanged, size_t upToDate) {
+    if (!verboseOutput) return;
+    std::cout << files << " files: " << written << " written, " << unchanged << " unchanged, " << upToDate << " up to date" << std::endl;
+}
 
-            std::string shaderProfile;
-            std::string resourceType;
-            std::string resourceIndex;
+int ProcessFiles(std::vector<std::filesystem::path> const& files, size_t jobs) {
+    int anyError = 0;
 
-            if (structuredVariables[i].semantic.has_value()) {
-                auto semantic = *structuredVariables[i].semantic;
-                if (semantic.parens.has_value()) {
-                    auto params = semantic.parens->params;
-                    shaderProfile = params[0].id.Val;
+    // Headers are read once per run, so a run in -watch mode sees the edits made since the last one
+    includeCache.Clear();
 
-                    if (params.size() >= 2) {
-                        resourceType = params[1].id.Val;
+    const size_t written = outputsWritten;
+    const size_t unchanged = outputsUnchanged;
+    const size_t upToDate = outputsUpToDate;
 
-                        if (params[1].arr.has_value()) {
-                            auto sizes = params[1].arr->Sizes;
-                            resourceIndex = sizes[0];
-                        }
-                    }
-                }
+    if (jobs <= 1) {
+        for (auto const& file : files) {
+            if (ProcessFile(file, std::cout, std::cerr))
+            {
+                std::cerr << "Failed to process " << file.string() << std::endl;
+                anyError = 1;
             }
+        }
+
+        anyError |= WriteIncludeDeclarations(std::cout, std::cerr);
+        ReportOutputs(files.size(), outputsWritten - written, outputsUnchanged - unchanged, outputsUpToDate - upToDate);
+        return anyError;
+    }
+
+    struct FileReport {
+        int result = 0;
+        std::ostringstream out;
+        std::ostringstream err;
+    };
+    std::vector<FileReport> reports(files.size());
+
+    ReflectHLSL::ThreadPool pool(jobs);
+    pool.ParallelFor(files.size(), [&](size_t i, size_t) {
+        reports[i].result = ProcessFile(files[i], reports[i].out, reports[i].err);
+    });
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::cout << reports[i].out.str() << std::flush;
+        std::cerr << reports[i].err.str();
+        if (reports[i].result)
+        {
+            std::cerr << "Failed to process " << files[i].string() << std::endl;
+            anyError = 1;
+        }
+    }
+
+    anyError |= WriteIncludeDeclarations(std::cout, std::cerr);
+    ReportOutputs(files.size(), outputsWritten - written, outputsUnchanged - unchanged, outputsUpToDate - upToDate);
+    return anyError;
+}
+
+int ScanDir(std::filesystem::path scanDirectory, size_t jobs) {
+    // Collect first so the report order is the directory order, no matter which worker finishes first
+    std::vector<std::filesystem::path> files;
+    for (auto& p : std::filesystem::recursive_directory_iterator(scanDirectory)) {
+        if (p.is_regular_file() && IsShaderSource(p.path())) {
+            files.push_back(p.path());
+        }
+    }
+
+    return ProcessFiles(files, jobs);
+}
+
+// One variant of a shader in a permutation spec
+struct Permutation {
+    std::filesystem::path Shader;
+    // Defined after the -D macros
+    ReflectHLSL::DefinesContext Defines;
+    // The defines as written, joined into a file name suffix. Empty for the shader without defines.
+    std::string Name;
+    std::filesystem::path Output;
+    std::filesystem::path SpvPath;
+    // Index of its PermutedShader
+    size_t Group = 0;
+
+    // Expanded source, and its top-level declarations as views into it
+    std::string Source;
+    std::vector<std::string_view> Declarations;
+    // The declarations not shared with every other permutation of the shader
+    std::string Own;
+    uint64_t CacheKey = 0;
+
+    int Result = 0;
+    std::ostringstream Out;
+    std::ostringstream Err;
+};
+
+// The permutations of one shader, and the declarations all of them have
+struct PermutedShader {
+    std::filesystem::path Shader;
+    std::vector<Permutation*> Permutations;
+    std::string Common;
+    // Set once Common is generated into <shader>.common.inl
+    std::optional<ReflectHLSL::SharedInclude> CommonInclude;
+    bool UpToDate = false;
+    bool Failed = false;
+};
 
-            ctx.Output += structuredVariables[i].GetName() + "(ctx, \"" + structuredVariables[i].GetName() + "\"";
+// Lines of <shader> [NAME[=VALUE]...], a permutation each. Shader paths are relative to the spec,
+// and # starts a comment.
+static bool ReadPermutationSpec(std::filesystem::path const& specPath, std::vector<std::unique_ptr<Permutation>>& permutations) {
+    std::ifstream spec(specPath);
+    if (!spec) {
+        std::cerr << "Failed to open permutation spec " << specPath.string() << std::endl;
+        return false;
+    }
+
+    std::set<std::filesystem::path> outputs;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(spec, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string shader;
+        if (!(fields >> shader)) continue;
 
-            if (!shaderProfile.empty()) {
-                ctx.Output += ", \"" + shaderProfile + "\"";
+        auto permutation = std::make_unique<Permutation>();
+        permutation->Shader = specPath.parent_path() / shader;
+
+        std::string define;
+        while (fields >> define) {
+            const size_t equals = define.find('=');
+            if (equals == 0) {
+                std::cerr << specPath.string() << "(" << lineNumber << "): No macro name in " << define << std::endl;
+                return false;
             }
 
-            if (!resourceType.empty()) {
-                ctx.Output += ", \"" + resourceType + "\"";
+            if (equals == std::string::npos) {
+                permutation->Defines.Define(define);
+            } else {
+                permutation->Defines.Define(define.substr(0, equals), define.substr(equals + 1));
             }
 
-            if (!resourceIndex.empty()) {
-                ctx.Output += ", " + resourceIndex;
+            if (!permutation->Name.empty()) permutation->Name.push_back('.');
+            for (char c : define) {
+                permutation->Name.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
             }
+        }
 
-            ctx.Output += ")\n";
+        // shader.comp.<name>.inl and shader.comp.<name>.spv, or the usual names for the permutation without defines
+        std::filesystem::path stem = permutation->Shader;
+        if (!permutation->Name.empty()) stem += "." + permutation->Name;
+        permutation->Output = stem;
+        permutation->Output += ".inl";
+        permutation->SpvPath = stem;
+        permutation->SpvPath += ".spv";
+
+        if (!outputs.insert(std::filesystem::absolute(permutation->Output).lexically_normal()).second) {
+            std::cerr << specPath.string() << "(" << lineNumber << "): " << permutation->Output.string() << " is already generated by another permutation" << std::endl;
+            return false;
         }
-        ctx.Output += "\t\t{ }\n";
 
-        // Try and load bytecode from the .spv file
-        {
-            std::vector<uint8_t> bytecode;
-            if (std::filesystem::exists(spvPath)) {
-				bytecode = loadFileBytes(spvPath);
-			}
+        permutations.push_back(std::move(permutation));
+    }
+
+    return true;
+}
 
-            const size_t size = bytecode.size();
-            const size_t roundedUpSize = (size + 7) & ~7;
+// Splits preprocessed source into top-level declarations: up to a ; outside any brackets, or up to a
+// closing } that isn't followed by one, like a function body or a cbuffer. An attribute stays with
+// the function after it.
+static void SplitDeclarations(std::string_view source, std::vector<std::string_view>& declarations) {
+    auto trimmed = [](std::string_view text) {
+        const size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos) return std::string_view();
+        return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    };
 
-            // Pad with zeros to make it 8 byte aligned
-            if (size != roundedUpSize) {
-				bytecode.resize(roundedUpSize);
+    size_t start = 0;
+    int depth = 0;
+    for (size_t i = 0; i < source.size(); ++i) {
+        const char c = source[i];
+        if (c == '"' || c == '\'') {
+            for (++i; i < source.size() && source[i] != c; ++i) {
+                if (source[i] == '\\') ++i;
             }
+            continue;
+        }
 
-            uint64_t* const bytecode64 = reinterpret_cast<uint64_t*>(bytecode.data());
-            const size_t numU64s = roundedUpSize / 8;
-            std::stringstream stream;
+        if (c == '{' || c == '(' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ')' || c == ']') {
+            --depth;
+        }
+        if (depth != 0) continue;
 
-            for (size_t i = 0; i < numU64s; ++i) {
-                if (i != 0) {
-					stream << ", ";
-                    if (i % 8 == 0) { // Visually nicer
-                        stream << "\n\t\t\t";
-                    }
-				}
-                stream << "0x" << std::hex << std::setw(16) << std::setfill('0') << bytecode64[i];// << "ull";
-			}
+        bool end = c == ';';
+        if (c == '}') {
+            const size_t next = source.find_first_not_of(" \t\r\n", i + 1);
+            end = next == std::string_view::npos || source[next] != ';';
+        }
 
-            ctx.Output += "\n\t\tstatic constexpr size_t BytecodeSize = " + std::to_string(size) + ";";
-            ctx.Output += "\n\t\tstatic constexpr uint8_t Bytecode[] = {\n\t\t\t" + stream.str() + "\n\t\t};\n";
+        if (end) {
+            const std::string_view declaration = trimmed(source.substr(start, i + 1 - start));
+            if (!declaration.empty()) declarations.push_back(declaration);
+            start = i + 1;
         }
+    }
 
-        writeFile(output, ReflectHLSL::Generate(ctx, dctx));
+    const std::string_view rest = trimmed(source.substr(start));
+    if (!rest.empty()) declarations.push_back(rest);
+}
 
-        std::cout << output.string() << std::endl;
+template<typename F>
+static void ForEachIdentifier(std::string_view text, F&& f) {
+    for (size_t i = 0; i < text.size();) {
+        if (!std::isalpha(static_cast<unsigned char>(text[i])) && text[i] != '_') {
+            // Skip the rest of a number, so the 0f of 1.0f isn't taken for a name
+            const bool number = std::isdigit(static_cast<unsigned char>(text[i]));
+            ++i;
+            while (number && i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_' || text[i] == '.')) ++i;
+            continue;
+        }
 
-        return 0;
+        const size_t start = i;
+        while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) ++i;
+        f(text.substr(start, i - start));
     }
-    catch (parsegen::parse_error const& ex) {
-        std::cerr << ex.what() << std::endl;
-        return 1;
+}
+
+// Finds the declarations every permutation of the shader has, the same number of times. One that names a
+// struct or cbuffer declared outside of them stays with each permutation, since the shared declarations
+// come first and can't see the others.
+static void SplitCommon(PermutedShader& shader) {
+    std::unordered_map<std::string_view, size_t> common;
+    for (std::string_view declaration : shader.Permutations[0]->Declarations) {
+        ++common[declaration];
     }
-    catch (std::exception const& ex) {
-        std::cerr << ex.what() << std::endl;
-        return 1;
+
+    for (size_t i = 1; i < shader.Permutations.size(); ++i) {
+        std::unordered_map<std::string_view, size_t> counts;
+        for (std::string_view declaration : shader.Permutations[i]->Declarations) {
+            ++counts[declaration];
+        }
+        for (auto& [declaration, count] : common) {
+            auto it = counts.find(declaration);
+            count = std::min(count, it == counts.end() ? size_t(0) : it->second);
+        }
+    }
+
+    // Takes the shared declarations out of a permutation, calling own for each of the rest
+    auto partition = [&](Permutation const& permutation, auto&& own) {
+        std::unordered_map<std::string_view, size_t> remaining = common;
+        for (std::string_view declaration : permutation.Declarations) {
+            auto it = remaining.find(declaration);
+            if (it != remaining.end() && it->second > 0) {
+                --it->second;
+            } else {
+                own(declaration);
+            }
+        }
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        std::set<std::string_view> ownTypes;
+        for (Permutation const* permutation : shader.Permutations) {
+            partition(*permutation, [&](std::string_view declaration) {
+                bool typeName = false;
+                ForEachIdentifier(declaration, [&](std::string_view id) {
+                    if (typeName) ownTypes.insert(id);
+                    typeName = id == "struct" || id == "cbuffer" || id == "tbuffer";
+                });
+            });
+        }
+
+        for (auto& [declaration, count] : common) {
+            if (count == 0) continue;
+            ForEachIdentifier(declaration, [&](std::string_view id) {
+                if (count != 0 && ownTypes.count(id) != 0) {
+                    count = 0;
+                    changed = true;
+                }
+            });
+        }
+    }
+
+    std::unordered_map<std::string_view, size_t> taken;
+    for (std::string_view declaration : shader.Permutations[0]->Declarations) {
+        auto it = common.find(declaration);
+        if (taken[declaration]++ < it->second) {
+            shader.Common.append(declaration);
+            shader.Common.push_back('\n');
+        }
+    }
+
+    for (Permutation* permutation : shader.Permutations) {
+        partition(*permutation, [&](std::string_view declaration) {
+            permutation->Own.append(declaration);
+            permutation->Own.push_back('\n');
+        });
     }
 }
 
-int ScanDir(std::filesystem::path scanDirectory) {
-    // Process all files in the current directory
-    int anyError = 0;
-    for (auto& p : std::filesystem::recursive_directory_iterator(scanDirectory)) {
-        const std::string extension = p.path().extension().string();
-        if (p.is_regular_file() && (extension == ".vert" || extension == ".frag" || extension == ".comp")) {
-            if (ProcessFile(p.path()))
-            {
-                std::cerr << "Failed to process " << p.path().string() << std::endl;
-                anyError = 1;
+int ProcessPermutations(std::filesystem::path specPath, size_t jobs) {
+    std::vector<std::unique_ptr<Permutation>> permutations;
+    if (!ReadPermutationSpec(specPath, permutations)) {
+        return 1;
+    }
+
+    // Headers are read once per run, as in ProcessFiles
+    includeCache.Clear();
+
+    const size_t written = outputsWritten;
+    const size_t unchanged = outputsUnchanged;
+    const size_t upToDate = outputsUpToDate;
+
+    ReflectHLSL::ThreadPool pool(jobs);
+
+    // Every permutation is expanded with its own macros
+    pool.ParallelFor(permutations.size(), [&](size_t i, size_t) {
+        Permutation& permutation = *permutations[i];
+        try {
+            ReflectHLSL::DefinesContext defines = predefinedMacros;
+            defines.Defines.insert(defines.Defines.end(), permutation.Defines.Defines.begin(), permutation.Defines.Defines.end());
+
+            const ReflectHLSL::MappedFile source(permutation.Shader);
+            ReflectHLSL::Preprocessor preprocessor(includeCache, includeDirs, defines);
+            preprocessor.Run(permutation.Shader, source.View(), permutation.Source);
+            SplitDeclarations(permutation.Source, permutation.Declarations);
+        }
+        catch (std::exception const& ex) {
+            permutation.Err << ex.what() << std::endl;
+            permutation.Result = 1;
+        }
+    });
+
+    // Permutations of the same shader are grouped in the order the spec first names it
+    std::vector<PermutedShader> shaders;
+    {
+        std::map<std::filesystem::path, size_t> index;
+        for (auto const& permutation : permutations) {
+            const auto [it, added] = index.emplace(std::filesystem::absolute(permutation->Shader).lexically_normal(), shaders.size());
+            if (added) {
+                shaders.emplace_back();
+                shaders.back().Shader = permutation->Shader;
+            }
+            shaders[it->second].Permutations.push_back(permutation.get());
+            permutation->Group = it->second;
+        }
+    }
+
+    for (PermutedShader& shader : shaders) {
+        for (Permutation* permutation : shader.Permutations) {
+            shader.Failed = shader.Failed || permutation->Result != 0;
+        }
+        if (shader.Failed) continue;
+
+        // What is shared, and so every output, depends on all of the shader's permutations
+        ReflectHLSL::Hasher matrix;
+        for (Permutation const* permutation : shader.Permutations) {
+            matrix.Update(permutation->Source);
+        }
+
+        shader.UpToDate = true;
+        for (Permutation* permutation : shader.Permutations) {
+            const ReflectHLSL::MappedFile bytecode = std::filesystem::exists(permutation->SpvPath) ? ReflectHLSL::MappedFile(permutation->SpvPath) : ReflectHLSL::MappedFile();
+            const uint64_t matrixHash = matrix.Digest();
+            permutation->CacheKey = ReflectHLSL::Hasher()
+                .Update(&toolFingerprint, sizeof(toolFingerprint))
+                .Update(permutation->Output.generic_string())
+                .Update(generationOptions.Fingerprint())
+                .Update(&matrixHash, sizeof(matrixHash))
+                .Update(bytecode.View())
+                .Digest();
+
+            shader.UpToDate = shader.UpToDate && buildCache.UpToDate(permutation->Output, permutation->CacheKey, permutation->Output);
+        }
+
+        if (shader.UpToDate) {
+            outputsUpToDate += shader.Permutations.size();
+        } else if (shader.Permutations.size() > 1 && !generationOptions.CpuKernels) {
+            SplitCommon(shader);
+        }
+    }
+
+    // The shared declarations of each shader are parsed once, into <shader>.common.inl
+    pool.ParallelFor(shaders.size(), [&](size_t i, size_t) {
+        PermutedShader& shader = shaders[i];
+        if (shader.Failed || shader.UpToDate || IsBlank(shader.Common)) return;
+
+        Permutation& first = *shader.Permutations[0];
+        try {
+            ReflectHLSL::AstArena::Scope arenaScope;
+            const ReflectHLSL::Program common = ReflectHLSL::SharedParser::ForThisThread().Parse(shader.Common);
+
+            ReflectHLSL::StringSink program;
+            ReflectHLSL::GenerationContext programCtx(program);
+            programCtx.StructLayout = generationOptions.StructLayout;
+            programCtx.StructOfArrays = generationOptions.StructOfArrays;
+            programCtx.DirtyTracking = generationOptions.DirtyTracking;
+            ReflectHLSL::GenerateProgram(programCtx, common);
+
+            std::filesystem::path inl = shader.Shader;
+            inl += ".common.inl";
+
+            ReflectHLSL::SharedInclude include;
+            include.Symbol = IncludeSymbol(inl, ReflectHLSL::Hasher::Of(shader.Common));
+            include.Types = ReflectHLSL::DeclaredTypes(programCtx, common);
+            include.InlPath = inl.filename().generic_string();
+
+            ReflectHLSL::FileSink sink(inl);
+            ReflectHLSL::GenerateIncludeFile(sink, "Declarations every permutation of " + shader.Shader.filename().string() + " has",
+                { { include.Symbol, program.Text() } });
+            if (sink.Finish()) {
+                first.Out << inl.string() << std::endl;
+            }
+
+            shader.CommonInclude = std::move(include);
+        }
+        catch (parsegen::parse_error const&) {
+            // Shared declarations that don't parse by themselves are parsed with each permutation
+        }
+        catch (std::exception const& ex) {
+            first.Err << ex.what() << std::endl;
+            first.Result = 1;
+        }
+    });
+
+    // Then each permutation's own declarations
+    pool.ParallelFor(permutations.size(), [&](size_t i, size_t) {
+        Permutation& permutation = *permutations[i];
+        if (permutation.Result != 0) return;
+
+        PermutedShader const& shader = shaders[permutation.Group];
+        if (shader.Failed || shader.UpToDate) return;
+
+        try {
+            auto& parse = ReflectHLSL::SharedParser::ForThisThread();
+            ReflectHLSL::AstArena::Scope arenaScope;
+
+            ReflectHLSL::Program p;
+            std::vector<ReflectHLSL::SharedInclude> includes;
+            if (shader.CommonInclude) {
+                try {
+                    if (!IsBlank(permutation.Own)) p = parse.Parse(permutation.Own);
+                    includes.push_back(*shader.CommonInclude);
+                }
+                catch (parsegen::parse_error const&) {
+                    p = parse.Parse(permutation.Source);
+                }
+            } else {
+                p = parse.Parse(permutation.Source);
             }
+
+            const ReflectHLSL::MappedFile bytecode = std::filesystem::exists(permutation.SpvPath) ? ReflectHLSL::MappedFile(permutation.SpvPath) : ReflectHLSL::MappedFile();
+            GenerateOutput(permutation.Output, permutation.CacheKey, permutation.Output, permutation.SpvPath, bytecode, p, permutation.Source, std::move(includes), permutation.Out);
+        }
+        catch (parsegen::parse_error const& ex) {
+            permutation.Err << ex.what() << std::endl;
+            permutation.Result = 1;
+        }
+        catch (std::exception const& ex) {
+            permutation.Err << ex.what() << std::endl;
+            permutation.Result = 1;
+        }
+    });
+
+    int anyError = 0;
+    for (auto const& permutation : permutations) {
+        std::cout << permutation->Out.str() << std::flush;
+        std::cerr << permutation->Err.str();
+        if (permutation->Result) {
+            std::cerr << "Failed to process " << permutation->Shader.string();
+            if (!permutation->Name.empty()) std::cerr << " (" << permutation->Name << ")";
+            std::cerr << std::endl;
+            anyError = 1;
         }
     }
 
+    ReportOutputs(permutations.size(), outputsWritten - written, outputsUnchanged - unchanged, outputsUpToDate - upToDate);
     return anyError;
 }
 
-int main(int argc, char** argv) {
-    // Get time point for when this executable was updated
-    {
-        const std::filesystem::path executablePath = argv[0];
-        lastWriteTime = std::filesystem::last_write_time(executablePath);
+// Accepts -j (all hardware threads), -jN and -j N
+static bool ParseJobs(std::vector<std::string>& args, size_t& jobs) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i].rfind("-j", 0) != 0) continue;
+
+        std::string count = args[i].substr(2);
+        size_t consumed = 1;
+        if (count.empty() && i + 1 < args.size() && !args[i + 1].empty() && std::isdigit(static_cast<unsigned char>(args[i + 1][0]))) {
+            count = args[i + 1];
+            consumed = 2;
+        }
+
+        if (count.empty()) {
+            jobs = ReflectHLSL::ThreadPool::HardwareThreads();
+        } else if (count.find_first_not_of("0123456789") == std::string::npos) {
+            jobs = std::max<size_t>(1, std::stoul(count));
+        } else {
+            std::cerr << "Invalid job count " << args[i] << std::endl;
+            return false;
+        }
+
+        args.erase(args.begin() + i, args.begin() + i + consumed);
+        --i;
+    }
+
+    return true;
+}
+
+// Accepts -cache <file> and -nocache, anywhere on the command line
+static bool ParseCache(std::vector<std::string>& args, std::filesystem::path& cachePath) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "-nocache") {
+            cachePath.clear();
+            args.erase(args.begin() + i);
+            --i;
+        } else if (args[i] == "-cache") {
+            if (i + 1 >= args.size()) {
+                std::cerr << "No file specified for -cache" << std::endl;
+                return false;
+            }
+            cachePath = args[i + 1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            --i;
+        }
+    }
+
+    return true;
+}
+
+// Accepts -bytecode hex|embed|incbin
+static bool ParseBytecodeMode(std::vector<std::string>& args, ReflectHLSL::BytecodeMode& mode) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != "-bytecode") continue;
+
+        const std::string value = i + 1 < args.size() ? args[i + 1] : std::string();
+        if (value == "hex") {
+            mode = ReflectHLSL::BytecodeMode::Hex;
+        } else if (value == "embed") {
+            mode = ReflectHLSL::BytecodeMode::Embed;
+        } else if (value == "incbin") {
+            mode = ReflectHLSL::BytecodeMode::Incbin;
+        } else {
+            std::cerr << "Invalid -bytecode mode '" << value << "', expected hex, embed or incbin" << std::endl;
+            return false;
+        }
+
+        args.erase(args.begin() + i, args.begin() + i + 2);
+        --i;
     }
 
+    return true;
+}
+
+// Accepts -layout std430|scalar
+static bool ParseLayout(std::vector<std::string>& args, ReflectHLSL::LayoutRules& rules) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != "-layout") continue;
+
+        const std::string value = i + 1 < args.size() ? args[i + 1] : std::string();
+        if (value == "std430") {
+            rules = ReflectHLSL::LayoutRules::Std430;
+        } else if (value == "scalar") {
+            rules = ReflectHLSL::LayoutRules::Scalar;
+        } else {
+            std::cerr << "Invalid -layout '" << value << "', expected std430 or scalar" << std::endl;
+            return false;
+        }
+
+        args.erase(args.begin() + i, args.begin() + i + 2);
+        --i;
+    }
+
+    return true;
+}
+
+// Accepts a flag like -soa, anywhere on the command line
+static void ParseFlag(std::vector<std::string>& args, std::string_view flag, bool& value) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != flag) continue;
+
+        value = true;
+        args.erase(args.begin() + i);
+        --i;
+    }
+}
+
+// Accepts -I <dir> and -I<dir>, and -D NAME[=VALUE] and -DNAME[=VALUE], anywhere on the command line
+static bool ParsePreprocessor(std::vector<std::string>& args) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const bool include = args[i].rfind("-I", 0) == 0;
+        const bool define = args[i].rfind("-D", 0) == 0;
+        if (!include && !define) continue;
+
+        std::string value = args[i].substr(2);
+        size_t consumed = 1;
+        if (value.empty() && i + 1 < args.size()) {
+            value = args[i + 1];
+            consumed = 2;
+        }
+        if (value.empty()) {
+            std::cerr << "No " << (include ? "directory" : "macro") << " specified for " << args[i] << std::endl;
+            return false;
+        }
+
+        if (include) {
+            includeDirs.push_back(value);
+        } else {
+            const size_t equals = value.find('=');
+            if (equals == std::string::npos) {
+                predefinedMacros.Define(value);
+            } else {
+                predefinedMacros.Define(value.substr(0, equals), value.substr(equals + 1));
+            }
+        }
+
+        args.erase(args.begin() + i, args.begin() + i + consumed);
+        --i;
+    }
+
+    return true;
+}
+
+static int Run(std::vector<std::string> const& args, size_t jobs) {
     // If -scan is passed, scan the directory for files to process
-    if (argc >= 2 && std::string(argv[1]) == "-scan") {
-		std::filesystem::path scanDirectory = argc >= 3 ? std::string(argv[2]) : std::string();
+    if (args.size() >= 1 && args[0] == "-scan") {
+		std::filesystem::path scanDirectory = args.size() >= 2 ? args[1] : std::string();
         if (scanDirectory.empty()) {
             std::cerr << "No directory specified for -scan" << std::endl;
             return 1;
         }
 
-        return ScanDir(scanDirectory);
-	} else if (argc >= 2 && std::string(argv[1]) == "-file") {
-        std::filesystem::path filePath = argc >= 3 ? std::string(argv[2]) : std::string();
+        return ScanDir(scanDirectory, jobs);
+	} else if (args.size() >= 1 && args[0] == "-watch") {
+        std::filesystem::path watchDirectory = args.size() >= 2 ? args[1] : std::string();
+        if (watchDirectory.empty()) {
+            std::cerr << "No directory specified for -watch" << std::endl;
+            return 1;
+        }
+
+        // Someone is watching the terminal, so say what each rescan did
+        verboseOutput = true;
+
+        return WatchDir(watchDirectory, jobs);
+	} else if (args.size() >= 1 && args[0] == "-permutations") {
+        std::filesystem::path specPath = args.size() >= 2 ? args[1] : std::string();
+        if (specPath.empty()) {
+            std::cerr << "No spec specified for -permutations" << std::endl;
+            return 1;
+        }
+
+        return ProcessPermutations(specPath, jobs);
+	} else if (args.size() >= 1 && args[0] == "-file") {
+        std::filesystem::path filePath = args.size() >= 2 ? args[1] : std::string();
         if (filePath.empty()) {
             std::cerr << "No file specified for -file" << std::endl;
 			return 1;
         }
-        return ProcessFile(filePath);
+
+        // Several files in one invocation share the grammar setup, which dominates a single short shader
+        if (args.size() > 2) {
+            return ProcessFiles(std::vector<std::filesystem::path>(args.begin() + 1, args.end()), jobs);
+        }
+        const int result = ProcessFile(filePath, std::cout, std::cerr);
+        return WriteIncludeDeclarations(std::cout, std::cerr) | result;
     }
     else
     {
-        return ScanDir(std::filesystem::current_path());
+        return ScanDir(std::filesystem::current_path(), jobs);
+    }
+}
+
+// argv[0] is only a fallback, since a tool started through PATH gets its bare name there, which names no
+// file relative to the working directory
+std::filesystem::path ExecutablePath(const char* argv0) {
+    std::error_code error;
+#if defined(_WIN32)
+    std::wstring path(MAX_PATH, L'\0');
+    for (;;) {
+        const DWORD length = GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+        if (length == 0) break;
+        if (length < path.size()) {
+            path.resize(length);
+            return path;
+        }
+        path.resize(path.size() * 2);
     }
+#elif defined(__APPLE__)
+    uint32_t size = 0;
+    _NSGetExecutablePath(nullptr, &size);
+    std::string path(size, '\0');
+    if (_NSGetExecutablePath(path.data(), &size) == 0) {
+        const std::filesystem::path resolved = std::filesystem::canonical(path.c_str(), error);
+        if (!error) return resolved;
+    }
+#else
+    const std::filesystem::path resolved = std::filesystem::read_symlink("/proc/self/exe", error);
+    if (!error) return resolved;
+#endif
+    return argv0 ? std::filesystem::path(argv0) : std::filesystem::path();
+}
+
+int main(int argc, char** argv) {
+    // Fingerprint this executable, so outputs of an older build are not reused
+    {
+        ReflectHLSL::Hasher hasher;
+        hasher.Update(REFLECTHLSL_VERSION);
+
+        const std::filesystem::path executablePath = ExecutablePath(argc > 0 ? argv[0] : nullptr);
+        std::error_code error;
+        if (std::filesystem::is_regular_file(executablePath, error)) {
+            const ReflectHLSL::MappedFile executable(executablePath);
+            hasher.Update(executable.Bytes(), executable.Length());
+        } else {
+            // Without the binary, at least tell builds apart by when they were compiled
+            hasher.Update(__DATE__ " " __TIME__);
+        }
+
+        toolFingerprint = hasher.Digest();
+    }
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    size_t jobs = 1;
+    if (!ParseJobs(args, jobs)) {
+        return 1;
+    }
+
+    std::filesystem::path cachePath = "ReflectHLSL.cache";
+    if (!ParseCache(args, cachePath)) {
+        return 1;
+    }
+
+    if (!ParseBytecodeMode(args, generationOptions.Bytecode)) {
+        return 1;
+    }
+
+    if (!ParseLayout(args, generationOptions.StructLayout)) {
+        return 1;
+    }
+
+    ParseFlag(args, "-soa", generationOptions.StructOfArrays);
+    ParseFlag(args, "-dirty", generationOptions.DirtyTracking);
+    ParseFlag(args, "-cpu", generationOptions.CpuKernels);
+    ParseFlag(args, "-verbose", verboseOutput);
+
+    if (!ParsePreprocessor(args)) {
+        return 1;
+    }
+
+    if (args.size() >= 1 && args[0] == "-bench") {
+        return ReflectHLSL::RunBenchmarks(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+
+    if (!cachePath.empty()) {
+        buildCache.Load(cachePath);
+
+        std::filesystem::path includesPath = cachePath;
+        includesPath += ".includes";
+        includeDeclarations.Load(includesPath);
+    }
+
+    const int result = Run(args, jobs);
+
+    SaveBuildCache();
+
+    return result;
 }
@@ -7,6 +7,7 @@
 #include <variant>
 #include <tuple>
 #include <filesystem>
+#include <type_traits>
 
 #include <frontend.hpp>
 
@@ -20,14 +21,15 @@ namespace ReflectHLSL {
         virtual void InitRules() override {
             {
                 Rule([](MaybeSpace, DeclarationList list) -> Program {
-                    return { list };
+                    return { std::move(list) };
                 });
 
+                // Lists are ArenaLists, appended to in place, so a long list is built in linear time
                 Rule([](AnyDecl decl) -> DeclarationList {
-                    return { { decl } };
+                    return { { std::move(decl) } };
                 });
                 Rule([](DeclarationList list, AnyDecl decl) -> DeclarationList {
-                    list.Val.push_back(decl);
+                    list.Val.push_back(std::move(decl));
                     return list;
                 });
 
@@ -39,28 +41,28 @@ namespace ReflectHLSL {
             // Creating Literals, output is LiteralValue
             {
                 Rule([](LiteralValue val) -> LiteralList {
-                    return { std::make_shared<LiteralValue>(val) };
+                    return { AstArena::ForThisThread().New<LiteralValue>(std::move(val)) };
                 });
                 Rule([](LiteralList list, MaybeSpace, Comma, MaybeSpace, LiteralValue val) -> LiteralList {
-                    list.push_back(std::make_shared<LiteralValue>(val));
+                    list.push_back(AstArena::ForThisThread().New<LiteralValue>(std::move(val)));
                     return list;
                 });
 
                 Rule([](LBrace, MaybeSpace, LiteralList list, MaybeSpace, RBrace) -> LiteralListEncapsulation {
-                    return { list };
+                    return { std::move(list) };
                 });
 
                 Rule([](Int val) -> LiteralValue {
-                    return { val.Val };
+                    return { std::move(val.Val) };
                 });
                 Rule([](Float val) -> LiteralValue {
-                    return { val.Val };
+                    return { std::move(val.Val) };
                 });
                 Rule([](ID val) -> LiteralValue {
-                    return { val.Val };
+                    return { std::move(val.Val) };
                 });
                 Rule([](LiteralListEncapsulation val) -> LiteralValue {
-                    return { LiteralTree { val.list } };
+                    return { LiteralTree { std::move(val.list) } };
                 });
             }
 
@@ -72,31 +74,31 @@ namespace ReflectHLSL {
                     //          int a[4] : register(b0) = { 0 };
                     Rule([]() -> MaybeArrayQuals { return std::nullopt; });
                     Rule([](ArrayQuals Quals) -> MaybeArrayQuals { return Quals; });
-                    Rule([](ArrayQual Qual) -> ArrayQuals { return { { Qual.Size } }; });
+                    Rule([](ArrayQual Qual) -> ArrayQuals { return { { std::move(Qual.Size) } }; });
                     Rule([](ArrayQuals Quals, ArrayQual Qual) -> ArrayQuals {
-                        Quals.Sizes.push_back(Qual.Size);
+                        Quals.Sizes.push_back(std::move(Qual.Size));
                         return Quals;
                     });
-                    Rule([](LBrack, MaybeSpace, ID id, MaybeSpace, RBrack, MaybeSpace) -> ArrayQual { return { id.Val }; });
-                    Rule([](LBrack, MaybeSpace, Int val, MaybeSpace, RBrack, MaybeSpace) -> ArrayQual { return { val.Val }; });
+                    Rule([](LBrack, MaybeSpace, ID id, MaybeSpace, RBrack, MaybeSpace) -> ArrayQual { return { std::move(id.Val) }; });
+                    Rule([](LBrack, MaybeSpace, Int val, MaybeSpace, RBrack, MaybeSpace) -> ArrayQual { return { std::move(val.Val) }; });
 
                     // Example:          vvvvvvvvvvvvvv
                     //          int a[4] : register(b0) = { 0 };
                     Rule([]() -> MaybeSemantic { return std::nullopt; });
                     Rule([](Colon, MaybeSpace, ID id, MaybeSpace, MaybeSemanticParens parens) -> MaybeSemantic {
-                        return Semantic { id, parens };
+                        return Semantic { std::move(id), std::move(parens) };
                     });
 
                     {
                         Rule([](ID id, MaybeSpace, MaybeArrayQuals arr) -> RegisterParam {
-                            return { id, arr };
+                            return { std::move(id), std::move(arr) };
                         });
                         
                         Rule([](RegisterParam param) -> RegisterParamList {
-                            return { param };
+                            return { std::move(param) };
                         });
                         Rule([](RegisterParamList list, Comma, MaybeSpace, RegisterParam param) -> RegisterParamList {
-                            list.push_back(param);
+                            list.push_back(std::move(param));
                             return list;
                         });
 
@@ -104,13 +106,13 @@ namespace ReflectHLSL {
                         //          int a[4] : register(b0) = { 0 };
                         Rule([]() -> MaybeSemanticParens { return std::nullopt; });
                         Rule([](LParen, MaybeSpace, RegisterParamList params, RParen, MaybeSpace) -> MaybeSemanticParens {
-                            return SemanticParens { params };
+                            return SemanticParens { std::move(params) };
                         });
                     }
 
                     // Example:                         vvvvvvv
                     //          int a[4] : register(b0) = { 0 };
-                    Rule([](Equals, MaybeSpace, LiteralValue val, MaybeSpace) -> Default { return { val }; });
+                    Rule([](Equals, MaybeSpace, LiteralValue val, MaybeSpace) -> Default { return { std::move(val) }; });
                 }
 
                 // Structs
@@ -119,13 +121,13 @@ namespace ReflectHLSL {
                     //          struct B { int x; };
                     Rule([](LBrace, MaybeSpace, MaybeDecList decList, RBrace, MaybeSpace) -> StructBody {
                         
-                        return { std::make_shared<MaybeDecList>(decList) };
+                        return { AstArena::ForThisThread().New<MaybeDecList>(std::move(decList)) };
                     });
 
                     // Example:            vvvvvv
                     //          struct B { int x; };
                     Rule([]() -> MaybeDecList { return { std::nullopt }; });
-                    Rule([](DeclarationList decList) -> MaybeDecList { return { decList }; });
+                    Rule([](DeclarationList decList) -> MaybeDecList { return { std::move(decList) }; });
                 }
 
                 // Determine whether the declaration is a variable or a struct
@@ -141,74 +143,68 @@ namespace ReflectHLSL {
                     Semicolon,
                     MaybeSpace
                 ) {
-                    return VarDecl{ ids, arr, sem, mode };
+                    return VarDecl{ std::move(ids), std::move(arr), std::move(sem), std::move(mode) };
                 });
             }
 
             // Various odds and ends
             {
                 Rule([](ID id) -> TemplateID {
-                    return { id, { } };
+                    return { std::move(id), { } };
                 });
                 Rule([](ID id, Less, ID templateId, Great) -> TemplateID {
-                    auto lit = std::make_shared<LiteralValue>(LiteralValue { templateId.Val });
-                    return { id, { lit } };
+                    auto lit = AstArena::ForThisThread().New<LiteralValue>(LiteralValue { templateId.Val });
+                    return { std::move(id), { lit } };
                 });
 
-                Rule([](TemplateID id) -> IDList { return { id }; });
+                Rule([](TemplateID id) -> IDList { return { std::move(id) }; });
                 Rule([](IDList list, MaybeSpace, TemplateID id) -> IDList {
-                    list.push_back(id);
+                    list.push_back(std::move(id));
                     return list;
                 });
 
                 Rule([](IDList ids) {
-                    return Param{
-                        ids[0].id.Val,
-                        ids.size() > 1 ? ids[1].id.Val : std::string()
-                    };
+                    return MakeParam(ids, { });
                 });
-                Rule([](IDList ids, MaybeSpace, Colon, MaybeSpace, ID) {
-                    return Param {
-                        ids[0].id.Val,
-                        ids.size() > 1 ? ids[1].id.Val : std::string()
-                    };
+                Rule([](IDList ids, MaybeSpace, Colon, MaybeSpace, ID semantic) {
+                    return MakeParam(ids, std::move(semantic));
                 });
                 Rule([](MaybeSpace) {
                     return ParamList { };
                 });
                 Rule([](Param param) {
-                    return ParamList { param };
+                    return ParamList { std::move(param) };
                 });
                 Rule([](ParamList paramList, Comma, MaybeSpace, Param param) {
-                    paramList.push_back(param);
+                    paramList.push_back(std::move(param));
                     return paramList;
                 });
 
                 Rule([](LBrack, MaybeSpace, ID id, MaybeSpace, LParen, MaybeSpace, LiteralList literals, RParen, MaybeSpace, RBrack, MaybeSpace) -> FunctionAttrib {
-                    return { id, literals };
+                    return { std::move(id), std::move(literals) };
                 });
 
                 Rule([](IDList ids, MaybeSpace, LParen, ParamList params, RParen, MaybeSpace, Scope, MaybeSpace) {
-                    ID returnType = ids[0].id;
-                    ID name = ids[1].id;
+                    ID returnType = std::move(ids[0].id);
+                    ID name = std::move(ids[1].id);
 
                     // Remove the return type and name from the list
                     ids.erase(ids.begin(), ids.begin() + 2);
                     
                     return FDecl{
-                        returnType,
-						name,
-                        params
+                        std::move(returnType),
+						std::move(name),
+                        std::move(params)
                     };
                 });
                 Rule([](IDList ids, MaybeSpace, LParen, ParamList params, RParen, MaybeSpace, Colon, MaybeSpace, ID, MaybeSpace, Scope, MaybeSpace) {
-                    ID returnType = ids[0].id;
-                    ID name = ids[1].id;
+                    ID returnType = std::move(ids[0].id);
+                    ID name = std::move(ids[1].id);
 
                     return FDecl{
-                        returnType,
-                        name,
-                        params
+                        std::move(returnType),
+                        std::move(name),
+                        std::move(params)
                     };
                 });
 
@@ -269,5 +265,56 @@ namespace ReflectHLSL {
         }
     
         HLSL() = default;
+
+    private:
+        // Example: inout float3 color : COLOR0, where only the type is required
+        static Param MakeParam(IDList const& ids, ID semantic) {
+            Param param;
+            if (ids.size() > 2) param.qualifier = ids[0].id;
+            param.typeName = ids[ids.size() > 2 ? ids.size() - 2 : 0].id;
+            if (ids.size() > 1) param.name = ids.back().id;
+            param.semantic = std::move(semantic);
+            return param;
+        }
+    };
+
+    // Building the grammar and its tables is far more expensive than parsing a
+    // typical shader, so it happens once per process rather than once per file.
+    // Where parsegen's Parse is const, it keeps its state to the call, so every
+    // thread parses with the one prototype and the tables exist once. Otherwise
+    // each thread parses with its own copy of the prototype, tables included,
+    // which -bench parser measures; if the parser can't be copied either, each
+    // thread builds its own grammar once and reuses it for every file it parses.
+    template<typename P>
+    concept ParsesConst = requires(P const& parser, std::string const& source) { parser.Parse(source); };
+
+    class SharedParser {
+    public:
+        using Parser = parsegen::Parser<HLSL>;
+
+        static constexpr bool SharesTables = ParsesConst<Parser>;
+        static constexpr bool CopiesTables = !SharesTables && std::is_copy_constructible_v<Parser>;
+
+        // What a thread parses with: the prototype itself, or the thread's own parser
+        using Handle = std::conditional_t<SharesTables, Parser const, Parser>;
+
+        static Parser const& Prototype() {
+            static const Parser prototype;
+            return prototype;
+        }
+
+        // A template only so the branches not taken aren't compiled; P is always Parser
+        template<typename P = Parser>
+        static auto& ForThisThread() {
+            if constexpr (ParsesConst<P>) {
+                return Prototype();
+            } else if constexpr (CopiesTables) {
+                thread_local Parser parser = Prototype();
+                return parser;
+            } else {
+                thread_local Parser parser;
+                return parser;
+            }
+        }
     };
 }
\ No newline at end of file
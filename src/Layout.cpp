@@ -0,0 +1,123 @@
+#include <utility>
+#include <algorithm>
+
+#include "Layout.hpp"
+
+namespace ReflectHLSL {
+    static constexpr uint32_t RegisterSize = 16;
+
+    static uint32_t RoundUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Reads a 1 to 4 dimension off the front of text
+    static bool ReadDimension(std::string_view& text, uint32_t& dimension) {
+        if (text.empty() || text[0] < '1' || text[0] > '4') return false;
+        dimension = static_cast<uint32_t>(text[0] - '0');
+        text.remove_prefix(1);
+        return true;
+    }
+
+    // std430 aligns vectors of 3 like vectors of 4
+    static uint32_t VectorAlignment(uint32_t components, uint32_t component, LayoutRules rules) {
+        if (rules != LayoutRules::Std430) return component;
+        return (components == 1 ? 1 : components == 2 ? 2 : 4) * component;
+    }
+
+    struct Component {
+        std::string_view Name;
+        std::string_view Type;
+        uint32_t Size;
+    };
+
+    static constexpr Component Components[] = {
+        { "float", "float", 4 }, { "int", "int32_t", 4 }, { "uint", "uint32_t", 4 }, { "dword", "uint32_t", 4 }, { "double", "double", 8 },
+    };
+
+    // Takes the component type off the front of type, like float off float3x4
+    static Component const* ReadComponent(std::string_view& type) {
+        for (auto const& component : Components) {
+            if (type.starts_with(component.Name)) {
+                type.remove_prefix(component.Name.size());
+                return &component;
+            }
+        }
+        return nullptr;
+    }
+
+    TypeLayout BuiltinLayout(std::string_view type, LayoutRules rules, bool rowMajor) {
+        Component const* read = ReadComponent(type);
+        if (!read) return { };
+        const uint32_t component = read->Size;
+
+        uint32_t rows = 1;
+        uint32_t columns = 1;
+        if (!type.empty() && !ReadDimension(type, rows)) return { };
+        const bool matrix = !type.empty() && type[0] == 'x';
+        if (matrix) {
+            type.remove_prefix(1);
+            if (!ReadDimension(type, columns)) return { };
+        }
+        if (!type.empty()) return { };
+
+        if (!matrix) {
+            return { rows * component, VectorAlignment(rows, component, rules) };
+        }
+
+        // Column major stores each column as a vector; row major each row
+        uint32_t vectors = columns;
+        uint32_t length = rows;
+        if (rowMajor) std::swap(vectors, length);
+
+        switch (rules) {
+        case LayoutRules::CBuffer:
+            return { RegisterSize * (vectors - 1) + length * component, RegisterSize };
+        case LayoutRules::Std430: {
+            const uint32_t stride = RoundUp(length * component, VectorAlignment(length, component, rules));
+            return { stride * vectors, VectorAlignment(length, component, rules) };
+        }
+        case LayoutRules::Scalar:
+            return { vectors * length * component, component };
+        }
+        return { };
+    }
+
+    bool VectorComponents(std::string_view type, std::string_view& component, uint32_t& count) {
+        Component const* read = ReadComponent(type);
+        if (!read) return false;
+
+        count = 1;
+        if (!type.empty() && !ReadDimension(type, count)) return false;
+        if (!type.empty()) return false;
+
+        component = read->Type;
+        return true;
+    }
+
+    bool LayoutBuilder::Place(TypeLayout type, uint32_t count, bool isStruct, uint32_t& offset) {
+        if (Rules == LayoutRules::CBuffer) {
+            if (count > 0 || isStruct || type.Alignment >= RegisterSize) {
+                // Starts a register. Array elements each start one, and the last one isn't padded.
+                if (count > 1 && type.Size % RegisterSize != 0) return false;
+                offset = RoundUp(End, RegisterSize);
+            } else {
+                // Packs into the current register unless it would straddle two
+                offset = RoundUp(End, type.Alignment);
+                if (offset % RegisterSize + type.Size > RegisterSize) offset = RoundUp(offset, RegisterSize);
+            }
+            Alignment = RegisterSize;
+        } else {
+            if (count > 1 && type.Size % type.Alignment != 0) return false;
+            offset = RoundUp(End, type.Alignment);
+            Alignment = std::max(Alignment, type.Alignment);
+        }
+
+        End = offset + type.Size * std::max<uint32_t>(count, 1);
+        return true;
+    }
+
+    TypeLayout LayoutBuilder::Finish() const {
+        const uint32_t alignment = Rules == LayoutRules::CBuffer ? RegisterSize : Alignment;
+        return { RoundUp(std::max<uint32_t>(End, 1), alignment), alignment };
+    }
+}
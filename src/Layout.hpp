@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <string_view>
+
+namespace ReflectHLSL {
+    // How members are placed in GPU memory: HLSL cbuffer packing (16 byte registers a member can't
+    // straddle, array elements and structs on register boundaries), std430, or scalar block layout
+    enum class LayoutRules : uint8_t {
+        CBuffer,
+        Std430,
+        Scalar,
+    };
+
+    // Size and alignment of a type under some LayoutRules. A size of zero means unknown.
+    struct TypeLayout {
+        uint32_t Size = 0;
+        uint32_t Alignment = 0;
+
+        bool Known() const { return Size != 0; }
+    };
+
+    // A struct or cbuffer a Program declares, with its layout when it could be computed
+    struct DeclaredType {
+        std::string Name;
+        TypeLayout Layout;
+        // As a member of a cbuffer, unknown if cbuffer packing would place its members differently
+        TypeLayout CBufferLayout;
+    };
+
+    // Layout of a scalar, vector or matrix type such as float, uint3 or float4x4. Matrices are column
+    // major unless rowMajor. Unknown for any other type.
+    TypeLayout BuiltinLayout(std::string_view type, LayoutRules rules, bool rowMajor = false);
+
+    // The C++ component type (float, int32_t, uint32_t or double) and component count of a scalar or vector
+    // type such as uint or float3. False for matrices and any other type.
+    bool VectorComponents(std::string_view type, std::string_view& component, uint32_t& count);
+
+    // Places the members of a struct or cbuffer one after another
+    class LayoutBuilder {
+    public:
+        explicit LayoutBuilder(LayoutRules rules) : Rules(rules) { }
+
+        // Offset of the next member. count is the number of array elements, or 0 if it isn't an array.
+        // Arrays whose element stride would differ from the element's size can't be mirrored by a C++
+        // array; for those this returns false and places nothing.
+        bool Place(TypeLayout type, uint32_t count, bool isStruct, uint32_t& offset);
+
+        // The whole, with the padding after the last member
+        TypeLayout Finish() const;
+
+    private:
+        LayoutRules Rules;
+        uint32_t End = 0;
+        uint32_t Alignment = 1;
+    };
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <span>
+#include <string>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace ReflectHLSL {
+    // Bytes from one element of a StructuredBuffer<T> to the next: the GpuSize of a struct generated with a
+    // GPU layout, otherwise sizeof(T), which matches for scalars and the tightly packed vectors of the VectorConfig
+    template<typename T>
+    constexpr size_t BufferStride = sizeof(T);
+
+    template<typename T> requires requires { T::GpuSize; }
+    constexpr size_t BufferStride<T> = T::GpuSize;
+
+    // Elements of type T, Stride bytes apart, in memory owned elsewhere such as a persistently mapped upload
+    // buffer. Elements are read and written in place; indices are checked by assert, so only in debug builds.
+    template<typename T, size_t Stride = BufferStride<T>>
+    class StridedSpan {
+        static_assert(std::is_trivially_copyable_v<T>, "elements are written to GPU memory byte for byte");
+        static_assert(Stride >= sizeof(T), "elements would overlap");
+
+    public:
+        StridedSpan() = default;
+
+        // The whole elements that fit in bytes, starting at data
+        StridedSpan(void* data, size_t bytes) : Data(static_cast<std::byte*>(data)), Count(bytes / Stride) {
+            assert(reinterpret_cast<uintptr_t>(data) % alignof(T) == 0 && "buffer memory isn't aligned for its elements");
+        }
+        explicit StridedSpan(std::span<std::byte> bytes) : StridedSpan(bytes.data(), bytes.size()) { }
+
+        inline size_t Size() const { return Count; }
+        inline bool Empty() const { return Count == 0; }
+        inline std::byte* Bytes() const { return Data; }
+
+        inline T& operator[](size_t index) const {
+            assert(index < Count && "buffer index out of range");
+            return *reinterpret_cast<T*>(Data + index * Stride);
+        }
+
+        // Copies values to elements [first, first + values.size()), in one memcpy when there is no gap between
+        // elements. Writes only whole elements front to back, which suits write combined memory.
+        void Write(size_t first, std::span<const T> values) const {
+            assert(first <= Count && values.size() <= Count - first && "buffer write out of range");
+            if constexpr (Stride == sizeof(T)) {
+                if (!values.empty()) std::memcpy(Data + first * Stride, values.data(), values.size_bytes());
+            } else {
+                for (size_t i = 0; i < values.size(); ++i) {
+                    std::memcpy(Data + (first + i) * Stride, &values[i], sizeof(T));
+                }
+            }
+        }
+
+    private:
+        std::byte* Data = nullptr;
+        size_t Count = 0;
+    };
+
+    // A Context for Programs using MappedBufferConfig: the memory of each buffer, by the name the shader gives it.
+    // Bind buffers before constructing the Program, whose StructuredBuffers look their memory up once.
+    class MappedBuffers {
+    public:
+        void Bind(std::string name, void* data, size_t bytes) {
+            Memory[std::move(name)] = std::span<std::byte>(static_cast<std::byte*>(data), bytes);
+        }
+
+        // Empty if nothing is bound to name
+        std::span<std::byte> Find(std::string_view name) const {
+            auto found = Memory.find(name);
+            return found == Memory.end() ? std::span<std::byte>() : found->second;
+        }
+
+    private:
+        std::map<std::string, std::span<std::byte>, std::less<>> Memory;
+    };
+
+    // A BufferConfig whose StructuredBuffer<T> and RWStructuredBuffer<T> are StridedSpans over the memory the
+    // Context has for them. Context may be anything with a Find(name) returning std::span<std::byte>, like MappedBuffers.
+    struct MappedBufferConfig {
+        template<typename T>
+        struct View : StridedSpan<T> {
+            View() = default;
+
+            // Called by the Program's constructor, with the register(...) of the buffer after its name
+            template<typename Context, typename... Register>
+            View(Context& ctx, const char* name, Register const&...) : StridedSpan<T>(ctx.Find(name)) { }
+        };
+
+        template<typename T> struct Buffer { using Type = View<T>; };
+        template<typename T> struct RWBuffer { using Type = View<T>; };
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <utility>
+#include <stdexcept>
+#include <string_view>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace ReflectHLSL {
+    // Read-only view of a whole file, mapped instead of read so loading it copies nothing.
+    // Empty files and files that can't be mapped (pipes, some network mounts) are read into memory instead.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(std::filesystem::path const& path) {
+#ifdef _WIN32
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open " + path.string());
+
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping) {
+                    Data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                    CloseHandle(mapping);
+                    if (Data) Size = static_cast<size_t>(size.QuadPart);
+                }
+            }
+            CloseHandle(file);
+#else
+            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) throw std::runtime_error("Failed to open " + path.string());
+
+            struct stat info;
+            if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+                void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    Data = static_cast<const char*>(mapped);
+                    Size = static_cast<size_t>(info.st_size);
+                }
+            }
+            close(fd);
+#endif
+
+            if (!Data) {
+                std::ifstream file(path, std::ios::binary);
+                Fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                Data = Fallback.data();
+                Size = Fallback.size();
+            }
+        }
+
+        ~MappedFile() {
+            Unmap();
+        }
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this == &other) return *this;
+            Unmap();
+
+            const bool fallback = other.Data == other.Fallback.data();
+            Fallback = std::move(other.Fallback);
+            Data = fallback ? Fallback.data() : other.Data;
+            Size = other.Size;
+
+            other.Data = nullptr;
+            other.Size = 0;
+            return *this;
+        }
+
+        inline std::string_view View() const { return { Data ? Data : "", Size }; }
+        inline const uint8_t* Bytes() const { return reinterpret_cast<const uint8_t*>(Data); }
+        inline size_t Length() const { return Size; }
+
+    private:
+        void Unmap() {
+            if (!Data || Data == Fallback.data()) return;
+#ifdef _WIN32
+            UnmapViewOfFile(Data);
+#else
+            munmap(const_cast<char*>(Data), Size);
+#endif
+            Data = nullptr;
+        }
+
+        const char* Data = nullptr;
+        size_t Size = 0;
+        std::string Fallback;
+    };
+}
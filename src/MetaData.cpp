@@ -1,187 +1,1110 @@
 #include "MetaData.hpp"
+#include "Translate.hpp"
+#include <cctype>
+#include <charconv>
+#include <algorithm>
 #include <stdexcept>
 
 namespace ReflectHLSL {
 #define RH_ASSERT(exp, info) {if(!(exp)) throw std::runtime_error(info);}
 
     std::string LiteralTree::format() const {
-        std::string res;
-        res += "{ ";
+        StringSink res;
+        formatTo(res);
+        return res.Text();
+    }
+
+    void LiteralTree::formatTo(OutputSink& out) const {
+        out += "{ ";
         for (size_t i = 0; i < children.size(); ++i) {
-            res += children[i]->format();
-            if ((i + 1) != (children.size())) res += ", ";
+            children[i]->formatTo(out);
+            if ((i + 1) != (children.size())) out += ", ";
         }
-        res += " }";
-        return res;
+        out += " }";
     }
 
     std::string LiteralValue::format() const {
+        StringSink res;
+        formatTo(res);
+        return res.Text();
+    }
+
+    void LiteralValue::formatTo(OutputSink& out) const {
         if (value.index() == 0) {
-            return std::get<std::string>(value);
+            out += std::get<std::string>(value);
         } else if (value.index() == 1) {
-            return std::get<LiteralTree>(value).format();
+            std::get<LiteralTree>(value).formatTo(out);
         }
         else {
             throw std::runtime_error("index was something that didn't exist");
         }
+    }
+
+    static bool HasQualifier(VarDecl const& v, std::string_view qualifier) {
+        for (auto const& id : v.ids) {
+            if (id.id.Val == qualifier) return true;
+        }
+        return false;
+    }
+
+    static bool IsStructDefinition(VarDecl const& v) {
+        return v.mode.has_value() && v.mode->index() == 1;
+    }
+
+    // Where the members of a struct or cbuffer go on the GPU, when the layout of every member is known
+    struct MemberPlacement {
+        VarDecl const* Member = nullptr;
+        uint32_t Offset = 0;
+        uint32_t Size = 0;
     };
 
-    void VarDecl::GetGeneration(GenerationContext& ctx, int tabs) {
-        const bool IsStruct = mode.has_value() && mode->index() == 1;
+    struct StructPlacement {
+        std::vector<MemberPlacement> Members;
+        TypeLayout Layout;
+        // Why there is no layout, if there isn't
+        std::string Problem;
+    };
 
-        std::string& res = ctx.Output;
+    static void ForEachMember(VarDecl const& decl, auto&& f) {
+        StructBody const& body = std::get<StructBody>(*decl.mode);
+        if (!body.Val->Val.has_value()) return;
+        for (auto const& member : body.Val->Val->Val) {
+            if (member.index() == 0) f(std::get<VarDecl>(member));
+        }
+    }
 
-        { // Setup name and qualifier
-            res += std::string(tabs, '\t');
+    static LayoutRules OwnRules(GenerationContext const& ctx, VarDecl const& decl) {
+        return decl.ids[0].id.Val == "cbuffer" ? LayoutRules::CBuffer : ctx.StructLayout;
+    }
 
-            if (IsStruct) {
-                StructBody body = std::get<StructBody>(*mode);
+    static void RecordStructLayouts(GenerationContext& ctx, VarDecl const& decl, StructPlacement const& own);
 
-                RH_ASSERT(ids.size() >= 1 && \
-                    ids.size() <= 2 && \
-                    (ids[0].id.Val == "struct" || ids[0].id.Val == "cbuffer"), \
-                    "Invalid struct declaration");
+    // Places the members of decl by rules, those of the block it is a member of, and its own by default
+    static StructPlacement PlaceMembers(GenerationContext& ctx, VarDecl const& decl, LayoutRules rules) {
+        StructPlacement placement;
+        LayoutBuilder builder(rules);
+        ForEachMember(decl, [&](VarDecl const& v) {
+            if (!placement.Problem.empty()) return;
 
-                res += "struct " + ids[1].id.Val;
-            } else {
-                for (auto ID : ids) {
-                    res += ID.id.Val + (ID.inTemplate.empty() ? std::string() : "<" + ID.inTemplate[0]->format() + ">") + " ";
+            // Nested struct definitions take no space, but members after them may use them
+            if (IsStructDefinition(v)) {
+                RecordStructLayouts(ctx, v, PlaceMembers(ctx, v, OwnRules(ctx, v)));
+                return;
+            }
+            if (HasQualifier(v, "static")) return;
+
+            std::string const& type = v.GetTypename();
+            bool isStruct = false;
+            TypeLayout layout;
+            if (v.ids[v.ids.size() > 2 ? 1 : 0].inTemplate.empty()) {
+                layout = BuiltinLayout(type, rules, HasQualifier(v, "row_major"));
+                if (!layout.Known()) {
+                    auto it = ctx.StructLayouts.find({ type, rules });
+                    if (it != ctx.StructLayouts.end()) {
+                        layout = it->second;
+                        isStruct = true;
+                    } else if (ctx.StructLayouts.contains({ type, ctx.StructLayout })) {
+                        placement.Problem = "cbuffer packing places the members of " + type + " differently than its own layout";
+                        return;
+                    }
+                }
+            }
+            if (!layout.Known()) {
+                placement.Problem = "the layout of " + type + " isn't known";
+                return;
+            }
+
+            uint32_t count = 0;
+            if (v.arrayQual.has_value()) {
+                count = 1;
+                for (auto const& size : v.arrayQual->Sizes) {
+                    uint32_t elements = 0;
+                    const auto [end, error] = std::from_chars(size.data(), size.data() + size.size(), elements);
+                    if (error != std::errc() || end != size.data() + size.size() || elements == 0) {
+                        placement.Problem = "array size " + size + " isn't a number";
+                        return;
+                    }
+                    count *= elements;
                 }
+            }
 
-                res.pop_back();
+            uint32_t offset = 0;
+            if (!builder.Place(layout, count, isStruct, offset)) {
+                placement.Problem = "elements of " + v.GetName() + " are spaced wider than a C++ array of " + type;
+                return;
             }
+            placement.Members.push_back({ &v, offset, layout.Size * std::max<uint32_t>(count, 1) });
+        });
+
+        placement.Layout = builder.Finish();
+        return placement;
+    }
+
+    static StructPlacement PlaceMembers(GenerationContext& ctx, VarDecl const& decl) {
+        return PlaceMembers(ctx, decl, OwnRules(ctx, decl));
+    }
+
+    // Remembers the layout of a struct for the structs and cbuffers declared after it. A cbuffer packs the members
+    // of a struct by its own rules, which only the C++ struct can mirror if they land where its own layout puts them,
+    // so the struct gets a cbuffer layout only if they do.
+    static void RecordStructLayouts(GenerationContext& ctx, VarDecl const& decl, StructPlacement const& own) {
+        if (!own.Problem.empty() || decl.ids.size() != 2) return;
+        std::string const& name = decl.ids[1].id.Val;
+        const LayoutRules rules = OwnRules(ctx, decl);
+        ctx.StructLayouts[{ name, rules }] = own.Layout;
+        if (rules == LayoutRules::CBuffer) return;
+
+        const StructPlacement packed = PlaceMembers(ctx, decl, LayoutRules::CBuffer);
+        const bool same = packed.Problem.empty() && packed.Layout.Size == own.Layout.Size &&
+            std::equal(packed.Members.begin(), packed.Members.end(), own.Members.begin(), own.Members.end(),
+                [](MemberPlacement const& a, MemberPlacement const& b) { return a.Offset == b.Offset; });
+        if (same) ctx.StructLayouts[{ name, LayoutRules::CBuffer }] = packed.Layout;
+    }
+
+    static bool ParseNumber(std::string_view text, uint32_t& value) {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && error == std::errc() && end == text.data() + text.size();
+    }
+
+    // The arguments of register(...): an optional shader profile, then the register as t1 or t[1], then an
+    // optional space2. Only a class letter followed by digits (or by [n]) is a register, so a profile like
+    // cs_5_0 is skipped however it starts. Returns false for c registers, which hold constants rather than descriptors.
+    static bool ResolveRegister(RegisterParamList const& params, ResourceBinding& binding) {
+        bool found = false;
+        for (auto const& param : params) {
+            std::string_view text = param.id.Val;
+
+            if (text.starts_with("space")) {
+                RH_ASSERT(ParseNumber(text.substr(5), binding.Space), "Invalid register space " + param.id.Val);
+                continue;
+            }
+            if (found || text.empty()) continue;
+
+            std::string_view slot = text.substr(1);
+            if (slot.empty() && param.arr.has_value() && param.arr->Sizes.size() == 1) slot = param.arr->Sizes[0];
+            uint32_t number = 0;
+            if (!ParseNumber(slot, number)) continue;	// A shader profile like ps_5_0
+
+            switch (text[0]) {
+            case 'b': binding.Class = ResourceBinding::RegisterClass::ConstantBuffer; break;
+            case 't': binding.Class = ResourceBinding::RegisterClass::ShaderResource; break;
+            case 'u': binding.Class = ResourceBinding::RegisterClass::UnorderedAccess; break;
+            case 's': binding.Class = ResourceBinding::RegisterClass::Sampler; break;
+            case 'c': return false;
+            default: continue;
+            }
+
+            binding.Slot = number;
+            found = true;
+        }
+        return found;
+    }
+
+    // Members, a constexpr table describing each data member so code can walk a struct at compile time
+    static void GenerateMemberTable(OutputSink& res, std::vector<std::pair<VarDecl const*, MemberPlacement const*>> const& members, int tabs) {
+        auto number = [&](uint32_t value) {
+            if (value == ~0u) res += "ReflectedMember::Unknown";
+            else res += std::to_string(value);
+        };
+
+        res.append(tabs, '\t');
+        res += "static constexpr std::array<ReflectedMember, ";
+        res += std::to_string(members.size());
+        res += "> Members = {";
+        if (members.empty()) {
+            res += " };\n";
+            return;
         }
+        res += " {\n";
+
+        for (auto const& [v, placed] : members) {
+            TemplateID const& type = v->ids[v->ids.size() > 2 ? 1 : 0];
+
+            res.append(tabs + 1, '\t');
+            res += "{ \"";
+            res += v->GetName();
+            res += "\", \"";
+            res += type.id.Val;
+            if (!type.inTemplate.empty()) {
+                res += '<';
+                type.inTemplate[0]->formatTo(res);
+                res += '>';
+            }
+            res += "\", ";
+            number(placed ? placed->Offset : ~0u);
+            res += ", ";
+            number(placed ? placed->Size : ~0u);
+            res += ", ";
+
+            // Dimensions holds the first four; the sizes may be macros, which the compiler evaluates
+            const size_t rank = v->arrayQual.has_value() ? v->arrayQual->Sizes.size() : 0;
+            res += std::to_string(rank);
+            res += ", {";
+            for (size_t i = 0; i < std::min<size_t>(rank, 4); ++i) {
+                res += i == 0 ? " " : ", ";
+                res += v->arrayQual->Sizes[i];
+            }
+            res += " }, \"";
+            if (v->semantic.has_value()) res += v->semantic->GetGeneration();
+            res += "\" },\n";
+        }
+
+        res.append(tabs, '\t');
+        res += "} };\n";
+    }
+
+    void VarDecl::GetGeneration(GenerationContext& ctx, int tabs) const {
+        const bool IsStruct = mode.has_value() && mode->index() == 1;
+
+        OutputSink& res = ctx.Output;
+
+        StructPlacement placement;
+        if (IsStruct) {
+            RH_ASSERT(ids.size() >= 1 && \
+                ids.size() <= 2 && \
+                (ids[0].id.Val == "struct" || ids[0].id.Val == "cbuffer"), \
+                "Invalid struct declaration");
+
+            placement = PlaceMembers(ctx, *this);
+        }
+        const bool laidOut = IsStruct && placement.Problem.empty();
+
+        { // Setup name and qualifier
+            res.append(tabs, '\t');
 
-        const std::string Identifier = IsStruct ? (ids[1].id.Val) : ids.back().id.Val;
+            if (IsStruct) {
+                res += "struct ";
+                if (laidOut) {
+                    res += "alignas(";
+                    res += std::to_string(placement.Layout.Alignment);
+                    res += ") ";
+                }
+                res += ids[1].id.Val;
+            } else {
+                for (size_t i = 0; i < ids.size(); ++i) {
+                    if (i != 0) res += ' ';
+                    res += ids[i].id.Val;
+                    if (!ids[i].inTemplate.empty()) {
+                        res += '<';
+                        ids[i].inTemplate[0]->formatTo(res);
+                        res += '>';
+                    }
+                }
+            }
+        }
 
         { // Array decls
             if (arrayQual.has_value()) {
-                for (auto size : arrayQual->Sizes) {
-                    res += "[" + size + "]";
+                for (auto const& size : arrayQual->Sizes) {
+                    res += '[';
+                    res += size;
+                    res += ']';
                 }
             }
         }
 
-        std::string semanticComment;
-
         { // Semantic
-            if (semantic.has_value()) {
-                semanticComment = " // : " + semantic->GetGeneration();
-
-                if (IsStruct) {
-                    //ctx.CBufferRegisterMap[Identifier] = semantic->parens->id.Val;
-                } else if (semantic->parens.has_value()) {
-                    //ctx.VarRegisterMap[Identifier] = semantic->parens->id.Val;
+            if (semantic.has_value() && semantic->id.Val == "register" && semantic->parens.has_value()) {
+                ResourceBinding binding;
+                if (ResolveRegister(semantic->parens->params, binding)) {
+                    binding.Name = IsStruct ? ids[1].id.Val : GetName();
+                    if (arrayQual.has_value()) {
+                        binding.Count.clear();
+                        for (auto const& size : arrayQual->Sizes) {
+                            if (!binding.Count.empty()) binding.Count += " * ";
+                            binding.Count += size;
+                        }
+                    }
+                    ctx.Bindings.push_back(std::move(binding));
                 }
             }
         }
+
+        auto appendSemanticComment = [&]() {
+            if (semantic.has_value()) {
+                res += " // : ";
+                res += semantic->GetGeneration();
+            }
+        };
         
         if (IsStruct) { // Is a struct
-            StructBody body = std::get<StructBody>(*mode);
+            res += " {";
+            appendSemanticComment();
+            res += '\n';
 
-            res += " {" + semanticComment + "\n";
-            if (body.Val->Val.has_value()) {
-                for (auto Decl : body.Val->Val->Val) {
-                    if (Decl.index() == 0) {
-                        std::get<VarDecl>(Decl).GetGeneration(ctx, tabs + 1);
-                    }
+            if (!laidOut) {
+                res.append(tabs + 1, '\t');
+                res += "// No GPU layout: ";
+                res += placement.Problem;
+                res += '\n';
+            }
+
+            // Explicit padding up to each member's GPU offset, so the struct can be copied to the GPU as is
+            uint32_t end = 0;
+            size_t paddings = 0;
+            size_t next = 0;
+            auto pad = [&](uint32_t offset) {
+                if (offset <= end) return;
+                res.append(tabs + 1, '\t');
+                res += "uint8_t _padding";
+                res += std::to_string(paddings++);
+                res += '[';
+                res += std::to_string(offset - end);
+                res += "];\n";
+            };
+
+            // Data members in order, with their placement if there is a layout
+            std::vector<std::pair<VarDecl const*, MemberPlacement const*>> reflected;
+
+            ForEachMember(*this, [&](VarDecl const& v) {
+                MemberPlacement const* placed = nullptr;
+                if (laidOut && next < placement.Members.size() && placement.Members[next].Member == &v) {
+                    placed = &placement.Members[next++];
+                    pad(placed->Offset);
+                    end = placed->Offset + placed->Size;
                 }
+                if (!IsStructDefinition(v) && !HasQualifier(v, "static")) reflected.emplace_back(&v, placed);
+                v.GetGeneration(ctx, tabs + 1);
+            });
+
+            // The size in the GPU layout is also the stride of a StructuredBuffer of it
+            if (laidOut) {
+                pad(placement.Layout.Size);
+                res.append(tabs + 1, '\t');
+                res += "static constexpr uint32_t GpuSize = ";
+                res += std::to_string(placement.Layout.Size);
+                res += ";\n";
             }
 
-            res += std::string(tabs, '\t') + "}";
+            GenerateMemberTable(res, reflected, tabs + 1);
+
+            res.append(tabs, '\t');
+            res += '}';
         } else {
             if (mode.has_value()) {
-                Default def = std::get<Default>(*mode);
-
-                res += " = " + def.Val.format();
+                res += " = ";
+                std::get<Default>(*mode).Val.formatTo(res);
             }
         }
 
-        res += ";";
+        res += ';';
 
         if (!IsStruct) {
-            res += semanticComment;
+            appendSemanticComment();
         }
 
-        res += "\n";
+        res += '\n';
+
+        if (laidOut) {
+            std::string const& name = ids[1].id.Val;
+            RecordStructLayouts(ctx, *this, placement);
+
+            auto check = [&](std::string_view expression, uint32_t value) {
+                res.append(tabs, '\t');
+                res += "static_assert(";
+                res += expression;
+                res += " == ";
+                res += std::to_string(value);
+                res += ");\n";
+            };
+
+            check("sizeof(" + name + ")", placement.Layout.Size);
+            for (auto const& member : placement.Members) {
+                check("offsetof(" + name + ", " + member.Member->GetName() + ")", member.Offset);
+            }
+        }
     }
 
-    inline std::string Semantic::GetGeneration() {
+    inline std::string const& Semantic::GetGeneration() const {
         return id.Val;// + (parens.has_value() ? ("(" + parens->id.Val + ")") : std::string());
     }
 
-    /*
-    std::string Semantic::format() const {
-         if (semanticName.empty()) return "";
-         std::string res;
-         res += " : ";
-         res += semanticName;
-         if (!inParens.empty()) {
-             res += "(";
-             res += inParens;
-             res += ")";
-         }
-         return res;
-     }
-
-    std::string ArrayQual::format() const {
-         if (!present) return "";
-         std::string res;
-         res += "[";
-         res += value;
-         res += "]";
-         return res;
-     }
-
-    std::string VarDeclaration::format() const {
-         std::string res;
-         res += storage;
-         if (!storage.empty()) res += " ";
-         res += type;
-         res += " ";
-         res += name;
-         res += arrayQual.format();
-         res += semantic.format();
-         if (hasDefault) {
-             res += " = ";
-             res += defaultValue.format();
-         }
-         return res + ";\n";
-     }
-
-    std::string StructDeclaration::format(int tabs) const {
-         std::string res;
-         res += std::string(tabs, '\t');
-         res += type;
-         res += " ";
-         res += name;
-         res += semantic.format();
-         if (declarations.empty()) return res + " { };\n";
-         res += " {\n";
-         for (auto v : declarations) {
-             if (v.index() == 0) {
-                 res += std::string(static_cast<size_t>(tabs) + 1, '\t');
-                 res += std::get<VarDeclaration>(v).format();
-             } else {
-                 res += std::get<StructDeclaration>(v).format(tabs + 1);
-             }
-         }
-         res += std::string(tabs, '\t');
-         res += "};\n";
-         return res;
-     }
-
-    std::string ProgramDeclaration::format() const {
-        std::string res;
-        for (auto v : declarations) {
-            if (v.index() == 0) {
-                res += std::get<VarDeclaration>(v).format();
+    // <Name>Columns, a structure of arrays mirroring a struct with a GPU layout, like a StructuredBuffer's elements.
+    // Scalars and vectors get a column per component; matrices, structs and arrays a column of whole values.
+    static void GenerateColumns(GenerationContext& ctx, VarDecl const& decl) {
+        const StructPlacement placement = PlaceMembers(ctx, decl);
+        if (!placement.Problem.empty() || placement.Members.empty()) return;
+
+        struct Column {
+            std::string Name;
+            std::string Type;
+            uint32_t Offset = 0;
+            bool Whole = false;
+        };
+
+        std::string const& name = decl.ids[1].id.Val;
+        std::vector<Column> columns;
+        for (auto const& member : placement.Members) {
+            VarDecl const& v = *member.Member;
+
+            std::string_view component;
+            uint32_t count = 0;
+            if (!v.arrayQual.has_value() && VectorComponents(v.GetTypename(), component, count)) {
+                if (count == 1) {
+                    columns.push_back({ v.GetName(), std::string(component), member.Offset });
+                    continue;
+                }
+
+                const uint32_t size = member.Size / count;
+                for (uint32_t i = 0; i < count; ++i) {
+                    columns.push_back({ v.GetName() + '_' + "xyzw"[i], std::string(component), member.Offset + i * size });
+                }
+                continue;
+            }
+
+            // Names the member's type as the struct sees it, nested structs and array dimensions included
+            columns.push_back({ v.GetName(), "decltype(" + name + "::" + v.GetName() + ")", member.Offset, true });
+        }
+
+        OutputSink& out = ctx.Output;
+
+        out += "\t\t// ";
+        out += name;
+        out += " as a structure of arrays, to fill on the CPU. Pack writes rows out as ";
+        out += name;
+        out += "s for upload.\n"
+            "\t\tstruct ";
+        out += name;
+        out += "Columns : ColumnStorage<";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i != 0) out += ", ";
+            out += columns[i].Type;
+        }
+        out += "> {\n"
+            "\t\t\tusing Base = ColumnStorage<";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i != 0) out += ", ";
+            out += columns[i].Type;
+        }
+        out += ">;\n"
+            "\t\t\tusing Base::Base;\n\n";
+
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const std::string index = std::to_string(i);
+
+            // A pointer to a whole member's type may not be spelled Type*, when it's an array
+            if (columns[i].Whole) {
+                out += "\t\t\tauto ";
+                out += columns[i].Name;
+                out += "() { return this->template Get<";
+                out += index;
+                out += ">(); }\n"
+                    "\t\t\tauto ";
+                out += columns[i].Name;
+                out += "() const { return this->template Get<";
+                out += index;
+                out += ">(); }\n";
+                continue;
+            }
+
+            out += "\t\t\t";
+            out += columns[i].Type;
+            out += "* ";
+            out += columns[i].Name;
+            out += "() { return this->template Get<";
+            out += index;
+            out += ">(); }\n"
+                "\t\t\t";
+            out += columns[i].Type;
+            out += " const* ";
+            out += columns[i].Name;
+            out += "() const { return this->template Get<";
+            out += index;
+            out += ">(); }\n";
+        }
+
+        out += "\n"
+            "\t\t\t// Writes rows [first, first + count) to destination, sizeof(";
+        out += name;
+        out += ") bytes each\n"
+            "\t\t\tvoid Pack(void* destination, size_t first, size_t count) const {\n"
+            "\t\t\t\tthis->template PackRows<";
+        out += std::to_string(placement.Layout.Size);
+        for (auto const& column : columns) {
+            out += ", ";
+            out += std::to_string(column.Offset);
+        }
+        out += ">(destination, first, count);\n"
+            "\t\t\t}\n"
+            "\t\t\tvoid Pack(void* destination) const { Pack(destination, 0, this->Size()); }\n"
+            "\t\t};\n";
+    }
+
+    // <Name>Tracked, a struct or cbuffer with a GPU layout and a setter per member recording the bytes it changes,
+    // so Flush uploads only those. Arrays can also be set an element at a time.
+    static void GenerateTracked(GenerationContext& ctx, VarDecl const& decl) {
+        const StructPlacement placement = PlaceMembers(ctx, decl);
+        if (!placement.Problem.empty() || placement.Members.empty()) return;
+
+        std::string const& name = decl.ids[1].id.Val;
+        OutputSink& out = ctx.Output;
+
+        out += "\t\t// ";
+        out += name;
+        out += " with setters recording what they change, for uploading only that\n"
+            "\t\tstruct ";
+        out += name;
+        out += "Tracked {\n"
+            "\t\t\t";
+        out += name;
+        out += " Data = { };\n"
+            "\t\t\tDirtyRanges Dirty;\n\n";
+
+        for (auto const& member : placement.Members) {
+            VarDecl const& v = *member.Member;
+            std::string const& field = v.GetName();
+            const std::string type = "decltype(" + name + "::" + field + ")";
+            const std::string offset = std::to_string(member.Offset);
+
+            out += "\t\t\tvoid set_";
+            out += field;
+            out += '(';
+            out += type;
+            if (v.arrayQual.has_value()) {
+                out += " const& value) { std::memcpy(&Data.";
+                out += field;
+                out += ", &value, sizeof(value)); Dirty.Mark(";
             } else {
-                res += std::get<StructDeclaration>(v).format();
+                out += " const& value) { Data.";
+                out += field;
+                out += " = value; Dirty.Mark(";
+            }
+            out += offset;
+            out += ", ";
+            out += std::to_string(member.Size);
+            out += "); }\n";
+
+            // Elements of an array with a layout have no gaps between them
+            if (v.arrayQual.has_value()) {
+                out += "\t\t\tvoid set_";
+                out += field;
+                out += "(size_t index, std::remove_extent_t<";
+                out += type;
+                out += "> const& value) { assert(index < std::extent_v<";
+                out += type;
+                out += "> && \"";
+                out += field;
+                out += " index out of range\"); std::memcpy(&Data.";
+                out += field;
+                out += "[index], &value, sizeof(value)); Dirty.Mark(";
+                out += offset;
+                out += " + index * sizeof(value), sizeof(value)); }\n";
+            }
+        }
+
+        out += "\n"
+            "\t\t\t// Calls upload(offset, source, size) for each region of changed bytes, see DirtyRanges::Flush\n"
+            "\t\t\ttemplate<typename Upload>\n"
+            "\t\t\tsize_t Flush(Upload&& upload, size_t alignment = 1) {\n"
+            "\t\t\t\tconst std::byte* bytes = reinterpret_cast<const std::byte*>(&Data);\n"
+            "\t\t\t\treturn Dirty.Flush([&](size_t offset, size_t size) { upload(offset, bytes + offset, size); }, alignment, sizeof(Data));\n"
+            "\t\t\t}\n"
+            "\n"
+            "\t\t\t// Copies the changed bytes to the same offsets of destination, the mapped ";
+        out += decl.ids[0].id.Val == "cbuffer" ? "cbuffer" : "copy";
+        out += "\n"
+            "\t\t\tsize_t FlushTo(void* destination, size_t alignment = 1) {\n"
+            "\t\t\t\treturn Flush([&](size_t offset, const void* source, size_t size) { std::memcpy(static_cast<std::byte*>(destination) + offset, source, size); }, alignment);\n"
+            "\t\t\t}\n"
+            "\t\t};\n";
+    }
+
+    // Visits each top-level declaration by const reference
+    struct ProgramGenerator {
+        explicit ProgramGenerator(GenerationContext& ctx) : ctx(ctx) { }
+
+        GenerationContext& ctx;
+
+        // [numthreads(x, y, z)] applies to the next function
+        FunctionAttrib const* currentInvokeSize = nullptr;
+        std::vector<VarDecl const*> structuredVariables;
+
+        // For the CPU versions: every function, the one with [numthreads] and its size, the cbuffers and groupshared variables
+        std::vector<FDecl const*> functions;
+        FDecl const* kernel = nullptr;
+        FunctionAttrib const* kernelSize = nullptr;
+        std::vector<VarDecl const*> cbuffers;
+        std::vector<VarDecl const*> groupShared;
+        std::vector<VarDecl const*> structs;
+
+        void operator()(VarDecl const& v) {
+            // Memory of a workgroup, not of the Program; the CPU versions keep it in GroupShared
+            if (HasQualifier(v, "groupshared")) {
+                groupShared.push_back(&v);
+                return;
+            }
+
+            v.GetGeneration(ctx, 2);
+
+            if (IsStructDefinition(v) && v.ids[0].id.Val == "cbuffer" && v.ids.size() == 2) {
+                cbuffers.push_back(&v);
+            }
+            if (IsStructDefinition(v) && v.ids[0].id.Val == "struct" && v.ids.size() == 2) {
+                structs.push_back(&v);
+            }
+
+            if (ctx.StructOfArrays && IsStructDefinition(v) && v.ids[0].id.Val == "struct") {
+                GenerateColumns(ctx, v);
+            }
+
+            if (ctx.DirtyTracking && IsStructDefinition(v) && v.ids.size() == 2) {
+                GenerateTracked(ctx, v);
+            }
+
+            if (v.GetTypename() == "StructuredBuffer" ||
+                v.GetTypename() == "RWStructuredBuffer")
+            {
+                structuredVariables.push_back(&v);
+            }
+        }
+
+        void operator()(FDecl const& func) {
+            OutputSink& out = ctx.Output;
+
+            out += "\n\t\t// ";
+            out += func.returnType.Val;
+
+            // Output all the parameter types
+            for (auto const& param : func.params) {
+                out += "\n\t\t// - ";
+                out += param.typeName.Val;
+                out += ' ';
+                out += param.name.Val;
+            }
+
+            functions.push_back(&func);
+            if (!func.name.Val.empty() && currentInvokeSize) {
+                kernel = &func;
+                kernelSize = currentInvokeSize;
+
+                out += "\n\t\tstatic constexpr uint3 " /*+ name +*/ "InvokeSize = uint3(";
+                currentInvokeSize->literals[0]->formatTo(out);
+                out += ", ";
+                currentInvokeSize->literals[1]->formatTo(out);
+                out += ", ";
+                currentInvokeSize->literals[2]->formatTo(out);
+                out += ");\n";
+                currentInvokeSize = nullptr;
+            }
+        }
+
+        // Case doesn't matter in semantics
+        static bool SameSemantic(std::string_view a, std::string_view b) {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+                return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+            });
+        }
+
+        // The type of a variable as TranslateBody tracks it: the element type of a buffer, and [] per array dimension
+        static std::string TranslatedType(VarDecl const& v) {
+            TemplateID const& type = v.ids[v.ids.size() > 2 ? 1 : 0];
+            std::string name = type.id.Val;
+            if ((name == "StructuredBuffer" || name == "RWStructuredBuffer") && !type.inTemplate.empty()) {
+                name = type.inTemplate[0]->format() + "[]";
+            }
+            if (v.arrayQual.has_value()) {
+                for (size_t i = 0; i < v.arrayQual->Sizes.size(); ++i) name += "[]";
+            }
+            return name;
+        }
+
+        // The member types of decl, and of the structs defined inside it
+        static void AddStructTypes(VarDecl const& decl, TranslationScope& scope) {
+            auto& members = scope.Structs[decl.ids[1].id.Val];
+            ForEachMember(decl, [&](VarDecl const& member) {
+                if (IsStructDefinition(member)) {
+                    if (member.ids.size() == 2) AddStructTypes(member, scope);
+                } else if (!HasQualifier(member, "static")) {
+                    members[member.GetName()] = TranslatedType(member);
+                }
+            });
+        }
+
+        // Appends the lines of code, which lost their indentation to the preprocessor, indented by their braces
+        static void AppendIndented(std::string_view code, size_t indent, std::string& out) {
+            size_t depth = 0;
+            while (!code.empty()) {
+                const size_t newline = code.find('\n');
+                std::string_view line = code.substr(0, newline);
+                code = newline == std::string_view::npos ? std::string_view() : code.substr(newline + 1);
+
+                const size_t start = line.find_first_not_of(" \t\r");
+                if (start == std::string_view::npos) continue;
+                line = line.substr(start, line.find_last_not_of(" \t\r") + 1 - start);
+
+                const size_t opened = std::count(line.begin(), line.end(), '{');
+                const size_t closed = std::count(line.begin(), line.end(), '}');
+                if (line.front() == '}' && depth > 0) --depth;
+                out.append(indent + depth, '\t');
+                out += line;
+                out += '\n';
+                depth += opened;
+                depth -= std::min(depth, closed - (line.front() == '}' ? 1 : 0));
+            }
+        }
+
+        // The functions as members running on the CPU, the groupshared variables as GroupShared, and RunGroup running
+        // every lane of a workgroup of the kernel. Nothing but a comment if any of them can't be translated.
+        void CpuVersions() {
+            OutputSink& out = ctx.Output;
+
+            TranslationScope scope;
+            for (VarDecl const* cbuffer : cbuffers) {
+                const std::string instance = cbuffer->ids[1].id.Val + "Data";
+                ForEachMember(*cbuffer, [&](VarDecl const& member) {
+                    if (IsStructDefinition(member)) {
+                        if (member.ids.size() == 2) AddStructTypes(member, scope);
+                    } else if (!HasQualifier(member, "static")) {
+                        scope.Globals[member.GetName()] = instance + '.' + member.GetName();
+                        scope.Types[member.GetName()] = TranslatedType(member);
+                    }
+                });
+            }
+            for (VarDecl const* decl : structs) AddStructTypes(*decl, scope);
+            for (VarDecl const* buffer : structuredVariables) scope.Types[buffer->GetName()] = TranslatedType(*buffer);
+
+            // Every function may reach groupshared memory, through the GroupShared of the group it runs for
+            for (VarDecl const* shared : groupShared) {
+                scope.Globals[shared->GetName()] = "Shared." + shared->GetName();
+                scope.Types[shared->GetName()] = TranslatedType(*shared);
+            }
+            if (!groupShared.empty()) {
+                scope.ImplicitArgument = "Shared";
+                for (FDecl const* func : functions) scope.Functions.insert(func->name.Val);
+            }
+
+            // Overloads are left out, since which one a call picks isn't known
+            std::set<std::string_view> overloaded;
+            for (FDecl const* func : functions) {
+                if (!scope.FunctionParameters.contains(func->name.Val)) {
+                    auto& types = scope.FunctionParameters[func->name.Val];
+                    for (Param const& param : func->params) {
+                        const bool reference = param.qualifier.Val == "out" || param.qualifier.Val == "inout";
+                        types.push_back(reference ? std::string() : param.typeName.Val);
+                    }
+                } else {
+                    overloaded.insert(func->name.Val);
+                }
+            }
+            for (std::string_view name : overloaded) scope.FunctionParameters.erase(scope.FunctionParameters.find(name));
+
+            std::string functionText;
+            std::string problem;
+            auto appendFunction = [&](FDecl const& func, std::string_view name, std::string_view body) {
+                functionText += "\n\t\t";
+                functionText += func.returnType.Val;
+                functionText += ' ';
+                functionText += name;
+                functionText += '(';
+                if (!groupShared.empty()) {
+                    functionText += "GroupShared& Shared";
+                    if (!func.params.empty()) functionText += ", ";
+                }
+                for (size_t i = 0; i < func.params.size(); ++i) {
+                    Param const& param = func.params[i];
+                    if (i != 0) functionText += ", ";
+                    functionText += param.typeName.Val;
+                    if (param.qualifier.Val == "out" || param.qualifier.Val == "inout") functionText += '&';
+                    functionText += ' ';
+                    functionText += param.name.Val;
+                }
+                functionText += ") {\n";
+
+                scope.Parameters.clear();
+                for (Param const& param : func.params) scope.Parameters[param.name.Val] = param.typeName.Val;
+                scope.ReturnType = func.returnType.Val;
+
+                std::string translated;
+                if (!TranslateBody(body, scope, translated, problem)) {
+                    problem = func.name.Val + ": " + problem;
+                    return false;
+                }
+                AppendIndented(translated, 3, functionText);
+                functionText += "\t\t}\n";
+                return true;
+            };
+
+            // The kernel split at its barriers, a function per phase when there is more than one
+            std::vector<std::string> kernelPhases;
+            for (FDecl const* func : functions) {
+                const std::string_view body = FindFunctionBody(ctx.Source, func->name.Val);
+                if (body.data() == nullptr) {
+                    problem = "the body of " + func->name.Val + " wasn't found";
+                    break;
+                }
+
+                if (func != kernel) {
+                    if (!appendFunction(*func, func->name.Val, body)) break;
+                    continue;
+                }
+
+                std::vector<std::string_view> phases;
+                if (!SplitAtBarriers(body, phases, problem)) {
+                    problem = func->name.Val + ": " + problem;
+                    break;
+                }
+                for (size_t i = 0; i < phases.size(); ++i) {
+                    kernelPhases.push_back(phases.size() == 1 ? func->name.Val : func->name.Val + "Phase" + std::to_string(i));
+                    if (!appendFunction(*func, kernelPhases.back(), phases[i])) break;
+                }
+                if (!problem.empty()) break;
+            }
+
+            // Values of the parameters with thread semantics, per component
+            std::string lanes[3];
+            std::string kernelArguments;
+            if (problem.empty() && kernel) {
+                for (size_t i = 0; i < 3; ++i) lanes[i] = kernelSize->literals.size() > i ? kernelSize->literals[i]->format() : "1";
+
+                kernelArguments = groupShared.empty() ? "(" : "(Shared";
+                for (size_t i = 0; i < kernel->params.size(); ++i) {
+                    Param const& param = kernel->params[i];
+                    const std::string& semantic = param.semantic.Val;
+
+                    std::vector<std::string> components;
+                    if (SameSemantic(semantic, "SV_DispatchThreadID")) {
+                        components = { "groupX * " + lanes[0] + " + x", "groupY * " + lanes[1] + " + y", "groupZ * " + lanes[2] + " + z" };
+                    } else if (SameSemantic(semantic, "SV_GroupID")) {
+                        components = { "groupX", "groupY", "groupZ" };
+                    } else if (SameSemantic(semantic, "SV_GroupThreadID")) {
+                        components = { "x", "y", "z" };
+                    } else if (SameSemantic(semantic, "SV_GroupIndex")) {
+                        components = { "(z * " + lanes[1] + " + y) * " + lanes[0] + " + x" };
+                    } else {
+                        problem = kernel->name.Val + ": parameter " + param.name.Val + " has no thread semantic";
+                        break;
+                    }
+
+                    std::string_view component;
+                    uint32_t count = 1;
+                    if (!VectorComponents(param.typeName.Val, component, count) || count > components.size()) {
+                        problem = kernel->name.Val + ": parameter " + param.name.Val + " isn't a vector of up to " + std::to_string(components.size());
+                        break;
+                    }
+
+                    if (i != 0 || !groupShared.empty()) kernelArguments += ", ";
+                    if (count == 1) {
+                        kernelArguments += components[0];
+                        continue;
+                    }
+                    kernelArguments += param.typeName.Val;
+                    kernelArguments += '(';
+                    for (uint32_t c = 0; c < count; ++c) {
+                        if (c != 0) kernelArguments += ", ";
+                        kernelArguments += components[c];
+                    }
+                    kernelArguments += ')';
+                }
+                kernelArguments += ')';
+            }
+
+            if (!problem.empty()) {
+                out += "\n\t\t// No CPU version: ";
+                out += problem;
+                out += '\n';
+                return;
+            }
+
+            out += "\n\t\t// CPU versions of the shader's functions\n";
+            for (VarDecl const* cbuffer : cbuffers) {
+                std::string const& name = cbuffer->ids[1].id.Val;
+                out += "\t\t";
+                out += name;
+                out += ' ';
+                out += name;
+                out += "Data = { };\n";
+            }
+
+            out += "\n\t\t// The groupshared memory of one workgroup. Dispatch keeps one per worker thread and reuses it for every group.\n"
+                "\t\tstruct GroupShared {\n";
+            for (VarDecl const* shared : groupShared) {
+                out += "\t\t\t";
+                out += shared->GetTypename();
+                out += ' ';
+                out += shared->GetName();
+                if (shared->arrayQual.has_value()) {
+                    for (auto const& size : shared->arrayQual->Sizes) {
+                        out += '[';
+                        out += size;
+                        out += ']';
+                    }
+                }
+                out += ";\n";
+            }
+            out += "\t\t};\n";
+            out += functionText;
+
+            if (!kernel) return;
+
+            out += "\n"
+                "\t\t// Runs every lane of workgroup (groupX, groupY, groupZ) on the calling thread, one after another, phase by phase\n"
+                "\t\t// when the kernel has barriers.\n"
+                "\t\tvoid RunGroup(uint32_t groupX, uint32_t groupY, uint32_t groupZ, GroupShared& Shared) {\n";
+            if (groupShared.empty()) out += "\t\t\t(void)Shared;\n";
+            for (std::string const& phase : kernelPhases) {
+                out += "\t\t\tfor (uint32_t z = 0; z < ";
+                out += lanes[2];
+                out += "; ++z) {\n"
+                    "\t\t\t\tfor (uint32_t y = 0; y < ";
+                out += lanes[1];
+                out += "; ++y) {\n"
+                    "\t\t\t\t\tfor (uint32_t x = 0; x < ";
+                out += lanes[0];
+                out += "; ++x) {\n"
+                    "\t\t\t\t\t\t";
+                out += phase;
+                out += kernelArguments;
+                out += ";\n"
+                    "\t\t\t\t\t}\n"
+                    "\t\t\t\t}\n"
+                    "\t\t\t}\n";
+            }
+            out += "\t\t}\n";
+        }
+
+        void operator()(FunctionAttrib const& attrib) {
+            currentInvokeSize = &attrib;
+        }
+
+        void Constructor() {
+            OutputSink& out = ctx.Output;
+
+            out += "\n\t\tinline Program(Context& ctx)\n";
+
+            // Shared headers' Programs are the bases, initialized first
+            size_t initializers = 0;
+            for (size_t i = 0; i < ctx.Includes.size(); ++i) {
+                out += initializers++ == 0 ? "\t\t: Include" : "\t\t, Include";
+                out += std::to_string(i);
+                out += "(ctx)\n";
+            }
+
+            for (size_t i = 0; i < structuredVariables.size(); ++i) {
+                VarDecl const& v = *structuredVariables[i];
+
+                out += initializers++ == 0 ? "\t\t: " : "\t\t, ";
+
+                std::string const* shaderProfile = nullptr;
+                std::string const* resourceType = nullptr;
+                std::string const* resourceIndex = nullptr;
+
+                if (v.semantic.has_value() && v.semantic->parens.has_value()) {
+                    RegisterParamList const& params = v.semantic->parens->params;
+                    shaderProfile = &params[0].id.Val;
+
+                    if (params.size() >= 2) {
+                        resourceType = &params[1].id.Val;
+
+                        if (params[1].arr.has_value()) {
+                            resourceIndex = &params[1].arr->Sizes[0];
+                        }
+                    }
+                }
+
+                out += v.GetName();
+                out += "(ctx, \"";
+                out += v.GetName();
+                out += '"';
+
+                if (shaderProfile && !shaderProfile->empty()) {
+                    out += ", \"";
+                    out += *shaderProfile;
+                    out += '"';
+                }
+
+                if (resourceType && !resourceType->empty()) {
+                    out += ", \"";
+                    out += *resourceType;
+                    out += '"';
+                }
+
+                if (resourceIndex && !resourceIndex->empty()) {
+                    out += ", ";
+                    out += *resourceIndex;
+                }
+
+                out += ")\n";
+            }
+            out += "\t\t{ }\n";
+        }
+    };
+
+    // Bindings, the explicit registers of this Program and of the shared headers' Programs it derives from
+    static void GenerateBindingTable(GenerationContext& ctx) {
+        static constexpr std::string_view Classes[] = {
+            "ReflectedBinding::ConstantBuffer",
+            "ReflectedBinding::ShaderResource",
+            "ReflectedBinding::UnorderedAccess",
+            "ReflectedBinding::Sampler",
+        };
+
+        OutputSink& out = ctx.Output;
+        out += "\n\t\tstatic constexpr std::array<ReflectedBinding, ";
+        out += std::to_string(ctx.Bindings.size());
+        out += "> OwnBindings = {";
+        if (ctx.Bindings.empty()) {
+            out += " };\n";
+        } else {
+            out += " {\n";
+            for (auto const& binding : ctx.Bindings) {
+                out += "\t\t\t{ \"";
+                out += binding.Name;
+                out += "\", ";
+                out += Classes[static_cast<size_t>(binding.Class)];
+                out += ", ";
+                out += std::to_string(binding.Slot);
+                out += ", ";
+                out += std::to_string(binding.Space);
+                out += ", ";
+                out += binding.Count;
+                out += " },\n";
+            }
+            out += "\t\t} };\n";
+        }
+
+        out += "\t\tstatic constexpr auto Bindings = ::ReflectHLSL::JoinBindings(";
+        for (size_t i = 0; i < ctx.Includes.size(); ++i) {
+            out += "Include";
+            out += std::to_string(i);
+            out += "::Bindings, ";
+        }
+        out += "OwnBindings);\n";
+    }
+
+    void GenerateProgram(GenerationContext& ctx, Program const& program) {
+        // Structs of shared headers can be members of this program's structs
+        for (auto const& include : ctx.Includes) {
+            for (auto const& type : include.Types) {
+                if (type.Layout.Known()) ctx.StructLayouts[{ type.Name, ctx.StructLayout }] = type.Layout;
+                if (type.CBufferLayout.Known()) ctx.StructLayouts[{ type.Name, LayoutRules::CBuffer }] = type.CBufferLayout;
+            }
+        }
+
+        ProgramGenerator generator { ctx };
+        for (auto const& decl : program.Val.Val) {
+            std::visit(generator, decl);
+        }
+        generator.Constructor();
+        GenerateBindingTable(ctx);
+        if (ctx.CpuKernels) generator.CpuVersions();
+    }
+
+    std::vector<DeclaredType> DeclaredTypes(GenerationContext const& ctx, Program const& program) {
+        std::vector<DeclaredType> types;
+        for (auto const& decl : program.Val.Val) {
+            if (decl.index() != 0) continue;
+
+            VarDecl const& v = std::get<VarDecl>(decl);
+            if (IsStructDefinition(v) && v.ids.size() == 2) {
+                DeclaredType type;
+                type.Name = v.ids[1].id.Val;
+                auto own = ctx.StructLayouts.find({ type.Name, ctx.StructLayout });
+                if (own != ctx.StructLayouts.end()) type.Layout = own->second;
+                auto packed = ctx.StructLayouts.find({ type.Name, LayoutRules::CBuffer });
+                if (packed != ctx.StructLayouts.end()) type.CBufferLayout = packed->second;
+                types.push_back(std::move(type));
             }
-            res += "\n";
         }
-        return res;
+        return types;
     }
-    */
 }
\ No newline at end of file
@@ -4,24 +4,27 @@
 #include <vector>
 #include <variant>
 #include <any>
-#include <memory>
 #include <optional>
 
+#include "Arena.hpp"
 #include "Generator.hpp"
 
 namespace ReflectHLSL {
     struct LiteralValue;
 
+    // Nodes behind pointers and ArenaList storage live in the thread's AstArena and are valid until it is reset
     struct LiteralTree {
-        std::vector<std::shared_ptr<LiteralValue>> children;
+        ArenaList<LiteralValue*> children;
 
         std::string format() const;
+        void formatTo(OutputSink& out) const;
         std::string generateLiteral() const;
     };
 
     struct LiteralValue {
         std::variant<std::string, LiteralTree> value;
         std::string format() const;
+        void formatTo(OutputSink& out) const;
     };
 
     // Token
@@ -46,7 +49,7 @@ namespace ReflectHLSL {
     struct SingleQuote { };
 
     // Nonterminals
-    using LiteralList = std::vector<std::shared_ptr<LiteralValue>>;
+    using LiteralList = ArenaList<LiteralValue*>;
     struct LiteralListEncapsulation {
         LiteralList list;
     };
@@ -54,7 +57,7 @@ namespace ReflectHLSL {
         ID id;
         LiteralList inTemplate;
     };
-    using IDList = std::vector<TemplateID>;
+    using IDList = ArenaList<TemplateID>;
     struct MaybeSpace { };
     struct Scope { };
     struct AnyOp { };
@@ -65,10 +68,12 @@ namespace ReflectHLSL {
         LiteralList literals;
     };
     struct Param {
+        ID qualifier;   // in, out or inout, if given
         ID typeName;
         ID name;
+        ID semantic;    // Like SV_DispatchThreadID, if given
     };
-    using ParamList = std::vector<Param>;
+    using ParamList = ArenaList<Param>;
     struct FDecl {
         ID returnType;
         ID name;
@@ -79,14 +84,14 @@ namespace ReflectHLSL {
         std::string Size;
     };
     struct ArrayQuals {
-        std::vector<std::string> Sizes;
+        ArenaList<std::string> Sizes;
     };
     using MaybeArrayQuals = std::optional<ArrayQuals>;
     struct RegisterParam {
         ID id;
         MaybeArrayQuals arr;
     };
-    using RegisterParamList = std::vector<RegisterParam>;
+    using RegisterParamList = ArenaList<RegisterParam>;
     struct SemanticParens {
         RegisterParamList params;
     };
@@ -95,12 +100,12 @@ namespace ReflectHLSL {
         ID id;
         MaybeSemanticParens parens;
 
-        std::string GetGeneration();
+        std::string const& GetGeneration() const;
     };
     using MaybeSemantic = std::optional<Semantic>;
     struct MaybeDecList;
     struct StructBody {
-        std::shared_ptr<MaybeDecList> Val;
+        MaybeDecList* Val = nullptr;
     };
     using DeclMode = std::optional<std::variant<Default, StructBody>>;
     struct VarDecl {
@@ -109,17 +114,17 @@ namespace ReflectHLSL {
         MaybeSemantic semantic;
         DeclMode mode;
 
-        void GetGeneration(GenerationContext& ctx, int tabs);
-        inline std::string GetTypename() const {
+        void GetGeneration(GenerationContext& ctx, int tabs) const;
+        inline std::string const& GetTypename() const {
             return (ids.size() > 2 ? ids[1] : ids[0]).id.Val;
         }
-        inline std::string GetName() const {
+        inline std::string const& GetName() const {
             return ids.back().id.Val;
         }
     };
     using AnyDecl = std::variant<VarDecl, FDecl, FunctionAttrib>;
     struct DeclarationList {
-        std::vector<AnyDecl> Val;
+        ArenaList<AnyDecl> Val;
     };
     struct MaybeDecList {
         std::optional<DeclarationList> Val;
@@ -127,4 +132,12 @@ namespace ReflectHLSL {
     struct Program {
         DeclarationList Val;
     };
+
+    // Appends the members and constructor of the generated Program struct for every declaration.
+    // Walks the AST by const reference and streams straight into ctx.Output, without copying nodes.
+    void GenerateProgram(GenerationContext& ctx, Program const& program);
+
+    // The structs and cbuffers program declares at the top level, which GenerateProgram turns into structs,
+    // with the layouts it computed for them in ctx
+    std::vector<DeclaredType> DeclaredTypes(GenerationContext const& ctx, Program const& program);
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <stdexcept>
+
+#include "OutputSink.hpp"
+
+namespace ReflectHLSL {
+    FileSink::FileSink(std::filesystem::path path)
+        : Path(std::move(path))
+        , Compare(std::make_unique<char[]>(BufferSize))
+    {
+        TempPath = Path;
+        TempPath += ".tmp";
+
+        Existing.open(Path, std::ios::binary);
+        if (!Existing) {
+            Diverge();
+        }
+    }
+
+    FileSink::~FileSink() {
+        // Abandoned without Finish, e.g. generation threw: leave the old file alone
+        if (!Finished && Temp.is_open()) {
+            Temp.close();
+            std::error_code ec;
+            std::filesystem::remove(TempPath, ec);
+        }
+    }
+
+    void FileSink::Drain(const char* data, size_t size) {
+        if (!Diverged) {
+            if (Existing.read(Compare.get(), size) && std::memcmp(Compare.get(), data, size) == 0) {
+                Matched += size;
+                return;
+            }
+            Diverge();
+        }
+
+        Temp.write(data, size);
+    }
+
+    // From here on the text goes to the temporary. It starts with the part that matched,
+    // copied back out of the old file.
+    void FileSink::Diverge() {
+        Diverged = true;
+
+        Temp.open(TempPath, std::ios::binary | std::ios::trunc);
+        if (!Temp) throw std::runtime_error("Failed to write " + TempPath.string());
+
+        if (Matched > 0) {
+            Existing.clear();
+            Existing.seekg(0);
+            for (uint64_t copied = 0; copied < Matched;) {
+                const size_t take = static_cast<size_t>(std::min<uint64_t>(BufferSize, Matched - copied));
+                if (!Existing.read(Compare.get(), take)) throw std::runtime_error("Failed to read " + Path.string());
+                Temp.write(Compare.get(), take);
+                copied += take;
+            }
+        }
+
+        Existing.close();
+    }
+
+    bool FileSink::Finish() {
+        Flush();
+
+        // Every byte matched, but the old file may still go on
+        if (!Diverged && Existing.peek() != std::ifstream::traits_type::eof()) {
+            Diverge();
+        }
+        Finished = true;
+
+        if (!Diverged) {
+            return false;
+        }
+
+        Temp.close();
+        if (!Temp) throw std::runtime_error("Failed to write " + TempPath.string());
+        std::filesystem::rename(TempPath, Path);
+        return true;
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <filesystem>
+
+#include "Cache.hpp"
+
+namespace ReflectHLSL {
+    // Destination for generated text. Writes collect in a fixed buffer that is drained in
+    // chunks, so generating a file takes the same memory however large the file is. Every
+    // drained byte is hashed on the way, which is what the cache records for the output.
+    class OutputSink {
+    public:
+        static constexpr size_t BufferSize = 64 * 1024;
+
+        OutputSink() : Buffer(std::make_unique<char[]>(BufferSize)) { }
+        virtual ~OutputSink() = default;
+
+        OutputSink(OutputSink const&) = delete;
+        OutputSink& operator=(OutputSink const&) = delete;
+
+        inline OutputSink& operator+=(std::string_view text) {
+            Write(text.data(), text.size());
+            return *this;
+        }
+
+        inline OutputSink& operator+=(char c) {
+            if (Used == BufferSize) Flush();
+            Buffer[Used++] = c;
+            return *this;
+        }
+
+        inline void append(size_t count, char c) {
+            while (count > 0) {
+                if (Used == BufferSize) Flush();
+                const size_t take = std::min(count, BufferSize - Used);
+                std::memset(Buffer.get() + Used, c, take);
+                Used += take;
+                count -= take;
+            }
+        }
+
+        inline void Write(const char* data, size_t size) {
+            while (size > 0) {
+                if (Used == BufferSize) Flush();
+                const size_t take = std::min(size, BufferSize - Used);
+                std::memcpy(Buffer.get() + Used, data, take);
+                Used += take;
+                data += take;
+                size -= take;
+            }
+        }
+
+        // At least count (up to BufferSize) writable bytes for formatting in place; Commit how many were used
+        inline char* Reserve(size_t count) {
+            if (BufferSize - Used < count) Flush();
+            return Buffer.get() + Used;
+        }
+
+        inline void Commit(size_t count) {
+            Used += count;
+        }
+
+        // Hands everything buffered to Drain
+        void Flush() {
+            if (Used == 0) return;
+            Hash.Update(Buffer.get(), Used);
+            Total += Used;
+            Drain(Buffer.get(), Used);
+            Used = 0;
+        }
+
+        // Hash and size of everything written so far
+        uint64_t Digest() { Flush(); return Hash.Digest(); }
+        uint64_t Size() const { return Total + Used; }
+
+    protected:
+        virtual void Drain(const char* data, size_t size) = 0;
+
+    private:
+        std::unique_ptr<char[]> Buffer;
+        size_t Used = 0;
+        uint64_t Total = 0;
+        Hasher Hash;
+    };
+
+    // Keeps nothing, only the hash and size
+    class HashingSink : public OutputSink {
+    protected:
+        void Drain(const char*, size_t) override { }
+    };
+
+    // Collects the text in memory
+    class StringSink : public OutputSink {
+    public:
+        std::string const& Text() { Flush(); return Contents; }
+
+    protected:
+        void Drain(const char* data, size_t size) override { Contents.append(data, size); }
+
+    private:
+        std::string Contents;
+    };
+
+    // Streams into a file, comparing against what the file already holds as it goes. If the
+    // text turns out identical the file is never touched, so its mtime stays put and nothing
+    // including it rebuilds. Otherwise the text goes to a temporary next to it, which Finish
+    // renames over the file.
+    class FileSink : public OutputSink {
+    public:
+        explicit FileSink(std::filesystem::path path);
+        ~FileSink() override;
+
+        // Returns whether the file was written
+        bool Finish();
+
+    protected:
+        void Drain(const char* data, size_t size) override;
+
+    private:
+        void Diverge();
+
+        std::filesystem::path Path;
+        std::filesystem::path TempPath;
+        std::ifstream Existing;
+        std::ofstream Temp;
+        std::unique_ptr<char[]> Compare;
+        uint64_t Matched = 0;
+        bool Diverged = false;
+        bool Finished = false;
+    };
+}
+
+// Writes text to path unless it is already there. Returns whether the file was written.
+inline bool writeFile(std::filesystem::path const& path, std::string_view text) {
+    ReflectHLSL::FileSink sink(path);
+    sink += text;
+    return sink.Finish();
+}
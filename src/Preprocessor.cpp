@@ -0,0 +1,1128 @@
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "Preprocessor.hpp"
+#include "MappedFile.hpp"
+
+namespace ReflectHLSL {
+    // Far deeper than any real include chain, but catches a header including itself without a guard
+    static constexpr size_t MaxIncludeDepth = 200;
+
+    // Index of the first of Chars at or after from, or the size if there is none. 16 bytes per step with SSE2.
+    template<char... Chars>
+    static size_t FindAny(std::string_view text, size_t from) {
+        const char* const data = text.data();
+        const size_t size = text.size();
+        size_t i = from;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        for (; i + 16 <= size; i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_setzero_si128();
+            ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Chars)))), ...);
+            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask != 0) {
+                return i + std::countr_zero(mask);
+            }
+        }
+#endif
+
+        for (; i < size; ++i) {
+            const char current = data[i];
+            if (((current == Chars) || ...)) return i;
+        }
+        return size;
+    }
+
+    static bool IsIdentifierStart(char c) {
+        return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static bool IsIdentifierChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static bool IsHorizontalSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    // Joins continued lines and replaces each comment with one space, all in one pass. A block comment
+    // spanning lines doesn't end the line it starts on. lineNumbers gets the original line of each line of out.
+    static void Clean(std::string_view text, std::string& out, std::vector<uint32_t>& lineNumbers) {
+        const size_t size = text.size();
+        out.reserve(size);
+
+        uint32_t line = 1;
+        lineNumbers.push_back(line);
+
+        size_t i = 0;
+        while (i < size) {
+            // Copy runs of characters that can't start a comment, literal or continuation
+            const size_t next = FindAny<'\n', '\\', '/', '"', '\''>(text, i);
+            out.append(text.data() + i, next - i);
+            i = next;
+            if (i == size) break;
+
+            const char current = text[i];
+            if (current == '\n') {
+                out += '\n';
+                lineNumbers.push_back(++line);
+                ++i;
+            } else if (current == '\\') {
+                size_t end = i + 1;
+                if (end < size && text[end] == '\r') ++end;
+                if (end < size && text[end] == '\n') {
+                    ++line;
+                    i = end + 1;
+                } else {
+                    out += '\\';
+                    ++i;
+                }
+            } else if (current == '"' || current == '\'') {
+                // Copied whole, so comment markers inside don't count
+                size_t end = i + 1;
+                while (end < size && text[end] != current && text[end] != '\n') {
+                    end += (text[end] == '\\' && end + 1 < size && text[end + 1] != '\n') ? 2 : 1;
+                }
+                if (end < size && text[end] == current) ++end;
+                out.append(text.data() + i, end - i);
+                i = end;
+            } else if (i + 1 < size && text[i + 1] == '/') {
+                // Up to the newline, which still ends the line. A backslash before it continues the comment.
+                size_t end = i + 2;
+                for (;;) {
+                    end = text.find('\n', end);
+                    if (end == std::string_view::npos) {
+                        end = size;
+                        break;
+                    }
+                    size_t last = end;
+                    if (last > i && text[last - 1] == '\r') --last;
+                    if (last > i + 2 && text[last - 1] == '\\') {
+                        ++line;
+                        ++end;
+                        continue;
+                    }
+                    break;
+                }
+                out += ' ';
+                i = end;
+            } else if (i + 1 < size && text[i + 1] == '*') {
+                const size_t close = text.find("*/", i + 2);
+                const size_t end = close == std::string_view::npos ? size : close + 2;
+                line += static_cast<uint32_t>(std::count(text.begin() + i, text.begin() + end, '\n'));
+                out += ' ';
+                i = end;
+            } else {
+                out += '/';
+                ++i;
+            }
+        }
+    }
+
+    // Length of the punctuator at the start of text, longest match first
+    static size_t PunctuatorLength(std::string_view text) {
+        static constexpr std::string_view Long[] = {
+            "<<=", ">>=", "...",
+            "##", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--", "->",
+            "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "::",
+        };
+
+        for (std::string_view punctuator : Long) {
+            if (text.starts_with(punctuator)) return punctuator.size();
+        }
+        return 1;
+    }
+
+    // Length and kind of the token at the start of text, which doesn't start with whitespace
+    static size_t Lex(std::string_view text, PPToken::Kind& kind) {
+        const char first = text[0];
+        size_t i = 1;
+
+        if (IsIdentifierStart(first)) {
+            kind = PPToken::Kind::Identifier;
+            while (i < text.size() && IsIdentifierChar(text[i])) ++i;
+            return i;
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(first)) || (first == '.' && text.size() > 1 && std::isdigit(static_cast<unsigned char>(text[1])))) {
+            // A pp-number: also takes suffixes and exponent signs, like 1.0e-5f and 0x10u
+            kind = PPToken::Kind::Number;
+            while (i < text.size()) {
+                const char c = text[i];
+                const char previous = text[i - 1];
+                if (IsIdentifierChar(c) || c == '.' || ((c == '+' || c == '-') && (previous == 'e' || previous == 'E' || previous == 'p' || previous == 'P'))) {
+                    ++i;
+                } else {
+                    break;
+                }
+            }
+            return i;
+        }
+
+        if (first == '"' || first == '\'') {
+            kind = PPToken::Kind::String;
+            while (i < text.size() && text[i] != first) {
+                i += (text[i] == '\\' && i + 1 < text.size()) ? 2 : 1;
+            }
+            return std::min(i + 1, text.size());
+        }
+
+        if (std::ispunct(static_cast<unsigned char>(first))) {
+            kind = PPToken::Kind::Punctuator;
+            return PunctuatorLength(text);
+        }
+
+        kind = PPToken::Kind::Other;
+        return 1;
+    }
+
+    std::shared_ptr<SourceFile const> SourceFile::Tokenize(std::filesystem::path path, std::string_view text) {
+        auto file = std::make_shared<SourceFile>();
+        file->Path = std::move(path);
+
+        std::vector<uint32_t> lineNumbers;
+        Clean(text, file->Text, lineNumbers);
+        file->Hash = Hasher::Of(file->Text);
+
+        // Text is final from here on, so views into it stay valid
+        const std::string_view clean = file->Text;
+        size_t start = 0;
+        for (size_t lineIndex = 0;; ++lineIndex) {
+            size_t end = clean.find('\n', start);
+            if (end == std::string_view::npos) end = clean.size();
+
+            Line line;
+            line.First = static_cast<uint32_t>(file->Tokens.size());
+            line.Number = lineNumbers[lineIndex];
+
+            bool space = false;
+            for (size_t i = start; i < end;) {
+                if (IsHorizontalSpace(clean[i])) {
+                    space = true;
+                    ++i;
+                    continue;
+                }
+
+                PPToken token;
+                const size_t length = Lex(clean.substr(i, end - i), token.Type);
+                token.Text = clean.substr(i, length);
+                token.Line = line.Number;
+                token.Space = space;
+                token.LineStart = file->Tokens.size() == line.First;
+                file->Tokens.push_back(token);
+
+                space = false;
+                i += length;
+            }
+
+            line.Count = static_cast<uint32_t>(file->Tokens.size()) - line.First;
+            if (line.Count > 0) {
+                line.Directive = file->Tokens[line.First].Text == "#";
+                file->Lines.push_back(line);
+            }
+
+            if (end == clean.size()) break;
+            start = end + 1;
+        }
+
+        // An #ifndef X ... #endif around everything makes including the file again a no-op while X is defined
+        auto directiveName = [&](Line const& line) {
+            return line.Directive && line.Count >= 2 ? file->Tokens[line.First + 1].Text : std::string_view();
+        };
+
+        auto const& lines = file->Lines;
+        if (lines.size() >= 2 && directiveName(lines.front()) == "ifndef" && lines.front().Count == 3 &&
+            file->Tokens[lines.front().First + 2].Type == PPToken::Kind::Identifier)
+        {
+            size_t depth = 0;
+            for (size_t i = 0; i < lines.size(); ++i) {
+                const std::string_view name = directiveName(lines[i]);
+                if (name == "if" || name == "ifdef" || name == "ifndef") {
+                    ++depth;
+                } else if ((name == "elif" || name == "else") && depth == 1) {
+                    break;
+                } else if (name == "endif" && --depth == 0) {
+                    if (i == lines.size() - 1) {
+                        file->Guard = file->Tokens[lines.front().First + 2].Text;
+                    }
+                    break;
+                }
+            }
+        }
+
+        return file;
+    }
+
+    std::shared_ptr<SourceFile const> IncludeCache::Load(std::filesystem::path const& path) {
+        const std::filesystem::path normal = std::filesystem::absolute(path).lexically_normal();
+        const std::string key = normal.generic_string();
+
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            auto it = Files.find(key);
+            if (it != Files.end()) return it->second;
+        }
+
+        // Tokenized outside the lock. If two threads miss on the same file at once, the first one stored wins.
+        const MappedFile mapped(normal);
+        auto file = SourceFile::Tokenize(normal, mapped.View());
+
+        std::lock_guard<std::mutex> lock(Mutex);
+        return Files.emplace(key, std::move(file)).first->second;
+    }
+
+    void IncludeCache::Clear() {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Files.clear();
+    }
+
+    size_t IncludeCache::Size() const {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return Files.size();
+    }
+
+    // #if expressions in 64 bit signed arithmetic. Identifiers left after expansion are 0, except true.
+    class ConditionEvaluator {
+    public:
+        explicit ConditionEvaluator(std::vector<PPToken> const& tokens) : Tokens(tokens) { }
+
+        int64_t Evaluate() {
+            const int64_t value = Ternary();
+            if (Position != Tokens.size()) {
+                throw std::runtime_error("unexpected '" + std::string(Tokens[Position].Text) + "'");
+            }
+            return value;
+        }
+
+    private:
+        static int Precedence(std::string_view op) {
+            if (op == "||") return 1;
+            if (op == "&&") return 2;
+            if (op == "|") return 3;
+            if (op == "^") return 4;
+            if (op == "&") return 5;
+            if (op == "==" || op == "!=") return 6;
+            if (op == "<" || op == ">" || op == "<=" || op == ">=") return 7;
+            if (op == "<<" || op == ">>") return 8;
+            if (op == "+" || op == "-") return 9;
+            if (op == "*" || op == "/" || op == "%") return 10;
+            return 0;
+        }
+
+        bool Accept(std::string_view text) {
+            if (Position < Tokens.size() && Tokens[Position].Text == text) {
+                ++Position;
+                return true;
+            }
+            return false;
+        }
+
+        void Expect(std::string_view text) {
+            if (!Accept(text)) {
+                throw std::runtime_error("expected '" + std::string(text) + "'");
+            }
+        }
+
+        int64_t Ternary() {
+            const int64_t condition = Binary(0);
+            if (!Accept("?")) return condition;
+
+            // Only the chosen branch can fail, like 0 ? 1 / 0 : 1
+            Skipping += condition ? 0 : 1;
+            const int64_t whenTrue = Ternary();
+            Skipping -= condition ? 0 : 1;
+            Expect(":");
+            Skipping += condition ? 1 : 0;
+            const int64_t whenFalse = Ternary();
+            Skipping -= condition ? 1 : 0;
+
+            return condition ? whenTrue : whenFalse;
+        }
+
+        int64_t Binary(int minPrecedence) {
+            int64_t left = Unary();
+            for (;;) {
+                if (Position == Tokens.size()) return left;
+                const std::string_view op = Tokens[Position].Text;
+                const int precedence = Precedence(op);
+                if (precedence == 0 || precedence <= minPrecedence) return left;
+                ++Position;
+
+                const bool shortCircuit = (op == "&&" && !left) || (op == "||" && left);
+                Skipping += shortCircuit ? 1 : 0;
+                const int64_t right = Binary(precedence);
+                Skipping -= shortCircuit ? 1 : 0;
+
+                left = Apply(op, left, right);
+            }
+        }
+
+        int64_t Apply(std::string_view op, int64_t left, int64_t right) const {
+            // Wrapping arithmetic through uint64_t, so overflow is not undefined behavior
+            const uint64_t l = static_cast<uint64_t>(left);
+            const uint64_t r = static_cast<uint64_t>(right);
+
+            if (op == "||") return left || right;
+            if (op == "&&") return left && right;
+            if (op == "|") return static_cast<int64_t>(l | r);
+            if (op == "^") return static_cast<int64_t>(l ^ r);
+            if (op == "&") return static_cast<int64_t>(l & r);
+            if (op == "==") return left == right;
+            if (op == "!=") return left != right;
+            if (op == "<") return left < right;
+            if (op == ">") return left > right;
+            if (op == "<=") return left <= right;
+            if (op == ">=") return left >= right;
+            if (op == "<<") return static_cast<int64_t>(l << (r & 63));
+            if (op == ">>") return left >> (r & 63);
+            if (op == "+") return static_cast<int64_t>(l + r);
+            if (op == "-") return static_cast<int64_t>(l - r);
+            if (op == "*") return static_cast<int64_t>(l * r);
+
+            if (right == 0 || (left == INT64_MIN && right == -1)) {
+                if (Skipping) return 0;
+                throw std::runtime_error("division by zero");
+            }
+            return op == "/" ? left / right : left % right;
+        }
+
+        int64_t Unary() {
+            if (Accept("(")) {
+                const int64_t value = Ternary();
+                Expect(")");
+                return value;
+            }
+            if (Accept("+")) return Unary();
+            if (Accept("-")) return static_cast<int64_t>(0 - static_cast<uint64_t>(Unary()));
+            if (Accept("!")) return !Unary();
+            if (Accept("~")) return ~Unary();
+
+            if (Position == Tokens.size()) {
+                throw std::runtime_error("expected a value");
+            }
+
+            PPToken const& token = Tokens[Position++];
+            switch (token.Type) {
+            case PPToken::Kind::Number:
+                return Number(token.Text);
+            case PPToken::Kind::Identifier:
+                return token.Text == "true" ? 1 : 0;
+            case PPToken::Kind::String:
+                if (token.Text.size() == 3 && token.Text[0] == '\'') return static_cast<unsigned char>(token.Text[1]);
+                [[fallthrough]];
+            default:
+                throw std::runtime_error("unexpected '" + std::string(token.Text) + "'");
+            }
+        }
+
+        static int64_t Number(std::string_view text) {
+            std::string_view digits = text;
+            while (!digits.empty() && (digits.back() == 'u' || digits.back() == 'U' || digits.back() == 'l' || digits.back() == 'L')) {
+                digits.remove_suffix(1);
+            }
+
+            int base = 10;
+            if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+                base = 16;
+                digits.remove_prefix(2);
+            } else if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B')) {
+                base = 2;
+                digits.remove_prefix(2);
+            } else if (digits.size() > 1 && digits[0] == '0') {
+                base = 8;
+                digits.remove_prefix(1);
+            }
+
+            uint64_t value = 0;
+            const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+            if (error != std::errc() || end != digits.data() + digits.size()) {
+                throw std::runtime_error("invalid integer '" + std::string(text) + "'");
+            }
+            return static_cast<int64_t>(value);
+        }
+
+        std::vector<PPToken> const& Tokens;
+        size_t Position = 0;
+        // Inside a branch whose value is not used
+        int Skipping = 0;
+    };
+
+    Preprocessor::Preprocessor(IncludeCache& includes, std::vector<std::filesystem::path> const& includeDirs, DefinesContext const& defines)
+        : Cache(includes), IncludeDirs(includeDirs), Defines(defines) { }
+
+    Preprocessor::~Preprocessor() = default;
+
+    void Preprocessor::Run(std::filesystem::path const& path, std::string_view source, std::string& out) {
+        Out = &out;
+        OutLines = 0;
+        LastWasWord = false;
+
+        // Predefined macros go through #define like any other
+        if (!Defines.Defines.empty()) {
+            std::string text;
+            for (auto const& [name, value] : Defines.Defines) {
+                text += "#define ";
+                text += name;
+                text += ' ';
+                text += value;
+                text += '\n';
+            }
+
+            Files.push_back(SourceFile::Tokenize("<command line>", text));
+            const size_t begin = out.size();
+            Process(*Files.back(), 0);
+
+            // Only the empty lines of the directives, which would move the shader's lines down
+            out.resize(begin);
+            OutLines = 0;
+        }
+
+        Files.push_back(SourceFile::Tokenize(std::filesystem::absolute(path).lexically_normal(), source));
+        Process(*Files.back(), 0);
+
+        if (!out.empty() && out.back() != '\n') {
+            out += '\n';
+        }
+    }
+
+    void Preprocessor::Process(SourceFile const& file, size_t depth) {
+        SourceFile const* const parent = CurrentFile;
+        CurrentFile = &file;
+
+        std::vector<Conditional> conditionals;
+
+        // Line n of the file is line lineOffset + n of the output. Includes move the lines after them down.
+        size_t lineOffset = OutLines;
+
+        // Lines between directives are expanded together, so a macro call can span lines
+        std::vector<PPToken> text;
+        std::vector<PPToken> expanded;
+        auto flush = [&]() {
+            if (text.empty()) return;
+            expanded.clear();
+            ExpandAll(text, expanded);
+            Emit(expanded, lineOffset);
+            text.clear();
+        };
+
+        for (auto const& line : file.Lines) {
+            if (line.Directive) {
+                flush();
+                EndLines(lineOffset + line.Number - 1);
+                Directive(file, line, conditionals, depth);
+
+                // An include takes the place of its line with the lines of the file
+                const size_t written = OutLines - (lineOffset + line.Number - 1);
+                if (written == 0) {
+                    EndLines(lineOffset + line.Number);
+                } else {
+                    lineOffset += written - 1;
+                }
+            } else if (conditionals.empty() || conditionals.back().Active) {
+                text.insert(text.end(), file.Tokens.begin() + line.First, file.Tokens.begin() + line.First + line.Count);
+            }
+        }
+        flush();
+        if (!file.Lines.empty()) {
+            EndLines(lineOffset + file.Lines.back().Number);
+        }
+
+        if (!conditionals.empty()) {
+            Fail(file.Lines.back().Number, "#if without #endif");
+        }
+
+        CurrentFile = parent;
+    }
+
+    void Preprocessor::Directive(SourceFile const& file, SourceFile::Line const& line, std::vector<Conditional>& conditionals, size_t depth) {
+        // A lone # does nothing, and neither does a # 12 "file" line marker
+        if (line.Count < 2 || file.Tokens[line.First + 1].Type != PPToken::Kind::Identifier) return;
+
+        const std::string_view name = file.Tokens[line.First + 1].Text;
+        PPToken const* const args = file.Tokens.data() + line.First + 2;
+        const size_t count = line.Count - 2;
+        const bool active = conditionals.empty() || conditionals.back().Active;
+
+        if (name == "if" || name == "ifdef" || name == "ifndef") {
+            Conditional conditional;
+            conditional.ParentActive = active;
+            if (active) {
+                if (name == "if") {
+                    conditional.Active = Evaluate(args, count, line.Number);
+                } else {
+                    if (count == 0 || args[0].Type != PPToken::Kind::Identifier) {
+                        Fail(line.Number, "#" + std::string(name) + " expects a macro name");
+                    }
+                    conditional.Active = (Macros.find(args[0].Text) != Macros.end()) == (name == "ifdef");
+                }
+                conditional.Taken = conditional.Active;
+            }
+            conditionals.push_back(conditional);
+            return;
+        }
+
+        if (name == "elif" || name == "else" || name == "endif") {
+            if (conditionals.empty()) {
+                Fail(line.Number, "#" + std::string(name) + " without #if");
+            }
+
+            Conditional& conditional = conditionals.back();
+            if (name == "endif") {
+                conditionals.pop_back();
+                return;
+            }
+            if (conditional.SeenElse) {
+                Fail(line.Number, "#" + std::string(name) + " after #else");
+            }
+
+            if (name == "else") {
+                conditional.SeenElse = true;
+                conditional.Active = conditional.ParentActive && !conditional.Taken;
+            } else {
+                // Only evaluated while no earlier branch was taken
+                conditional.Active = conditional.ParentActive && !conditional.Taken && Evaluate(args, count, line.Number);
+            }
+            conditional.Taken = conditional.Taken || conditional.Active;
+            return;
+        }
+
+        // Anything else in a skipped branch is ignored, even unknown directives
+        if (!active) return;
+
+        if (name == "define") {
+            Define(args, count, line.Number);
+        } else if (name == "undef") {
+            if (count == 0 || args[0].Type != PPToken::Kind::Identifier) {
+                Fail(line.Number, "#undef expects a macro name");
+            }
+            auto it = Macros.find(args[0].Text);
+            if (it != Macros.end()) {
+                Macros.erase(it);
+            }
+        } else if (name == "include") {
+            Include(file, args, count, line.Number, depth);
+        } else if (name == "pragma") {
+            // Other pragmas (pack_matrix, warning, ...) don't change the declarations that are reflected
+            if (count == 1 && args[0].Text == "once") {
+                Once.insert(file.Path.generic_string());
+            }
+        } else if (name == "error") {
+            std::string message = "#error";
+            for (size_t i = 0; i < count; ++i) {
+                message += ' ';
+                message += args[i].Text;
+            }
+            Fail(line.Number, message);
+        } else if (name != "line" && name != "warning") {
+            Fail(line.Number, "unknown directive #" + std::string(name));
+        }
+    }
+
+    void Preprocessor::Define(PPToken const* tokens, size_t count, uint32_t line) {
+        if (count == 0 || tokens[0].Type != PPToken::Kind::Identifier) {
+            Fail(line, "#define expects a macro name");
+        }
+        if (tokens[0].Text == "defined") {
+            Fail(line, "'defined' cannot be a macro name");
+        }
+
+        Macro macro;
+        size_t i = 1;
+
+        // A parenthesis straight after the name makes it function-like
+        if (i < count && tokens[i].Text == "(" && !tokens[i].Space) {
+            macro.FunctionLike = true;
+            ++i;
+
+            if (i < count && tokens[i].Text == ")") {
+                ++i;
+            } else {
+                for (;;) {
+                    if (i < count && tokens[i].Text == "...") {
+                        macro.Variadic = true;
+                        macro.Params.push_back("__VA_ARGS__");
+                        if (++i >= count || tokens[i].Text != ")") {
+                            Fail(line, "expected ')' after '...'");
+                        }
+                        ++i;
+                        break;
+                    }
+
+                    if (i >= count || tokens[i].Type != PPToken::Kind::Identifier) {
+                        Fail(line, "expected a parameter name in macro '" + std::string(tokens[0].Text) + "'");
+                    }
+                    macro.Params.push_back(tokens[i++].Text);
+
+                    if (i < count && tokens[i].Text == ",") {
+                        ++i;
+                    } else if (i < count && tokens[i].Text == ")") {
+                        ++i;
+                        break;
+                    } else {
+                        Fail(line, "expected ',' or ')' in the parameters of macro '" + std::string(tokens[0].Text) + "'");
+                    }
+                }
+            }
+        }
+
+        macro.Body.assign(tokens + i, tokens + count);
+        if (!macro.Body.empty()) {
+            macro.Body.front().Space = false;
+            macro.Body.front().LineStart = false;
+
+            if (macro.Body.front().Text == "##" || macro.Body.back().Text == "##") {
+                Fail(line, "'##' cannot be at either end of a macro");
+            }
+        }
+
+        if (macro.FunctionLike) {
+            for (size_t b = 0; b < macro.Body.size(); ++b) {
+                if (macro.Body[b].Text != "#") continue;
+                const bool parameter = b + 1 < macro.Body.size() &&
+                    std::find(macro.Params.begin(), macro.Params.end(), macro.Body[b + 1].Text) != macro.Params.end();
+                if (!parameter) {
+                    Fail(line, "'#' is not followed by a parameter of macro '" + std::string(tokens[0].Text) + "'");
+                }
+            }
+        }
+
+        // Redefinitions replace the old definition
+        Macros.insert_or_assign(std::string(tokens[0].Text), std::move(macro));
+    }
+
+    void Preprocessor::Include(SourceFile const& file, PPToken const* tokens, size_t count, uint32_t line, size_t depth) {
+        // #include MACRO is expanded first
+        std::vector<PPToken> expanded;
+        if (count > 0 && tokens[0].Type == PPToken::Kind::Identifier) {
+            ExpandAll(std::vector<PPToken>(tokens, tokens + count), expanded);
+            tokens = expanded.data();
+            count = expanded.size();
+        }
+
+        std::string name;
+        bool quoted = false;
+        if (count >= 1 && tokens[0].Type == PPToken::Kind::String && tokens[0].Text.size() >= 2 && tokens[0].Text.front() == '"') {
+            name = tokens[0].Text.substr(1, tokens[0].Text.size() - 2);
+            quoted = true;
+        } else if (count >= 1 && tokens[0].Text == "<") {
+            size_t i = 1;
+            for (; i < count && tokens[i].Text != ">"; ++i) {
+                if (i > 1 && tokens[i].Space) name += ' ';
+                name += tokens[i].Text;
+            }
+            if (i == count) {
+                Fail(line, "expected '>' after #include <" + name);
+            }
+        }
+        if (name.empty()) {
+            Fail(line, "#include expects \"file\" or <file>");
+        }
+
+        // "file" is looked for next to the including file first, then like <file> in the include directories
+        std::filesystem::path found;
+        auto tryPath = [&](std::filesystem::path const& candidate) {
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(candidate, ec)) return false;
+            found = candidate;
+            return true;
+        };
+
+        if (!(quoted && tryPath(file.Path.parent_path() / name))) {
+            for (auto const& dir : IncludeDirs) {
+                if (tryPath(dir / name)) break;
+            }
+        }
+
+        if (found.empty()) {
+            Fail(line, "cannot open include file '" + name + "'");
+        }
+        if (depth + 1 > MaxIncludeDepth) {
+            Fail(line, "#include nested too deeply");
+        }
+
+        std::shared_ptr<SourceFile const> included = Cache.Load(found);
+        if (Once.find(included->Path.generic_string()) != Once.end()) return;
+        if (!included->Guard.empty() && Macros.find(included->Guard) != Macros.end()) return;
+
+        if (std::find(IncludedFiles.begin(), IncludedFiles.end(), included->Path) == IncludedFiles.end()) {
+            IncludedFiles.push_back(included->Path);
+        }
+
+        // Macros defined in it point into its text, so it is kept until the end of the run
+        Files.push_back(included);
+
+        // Process starts it on a line of its own and ends its last line
+        std::string& out = *Out;
+        const bool topLevel = depth == 0;
+        if (topLevel) {
+            RegionSource = Hasher();
+        }
+
+        RegionSource.Update(&included->Hash, sizeof(included->Hash));
+        const size_t begin = out.size();
+        const size_t beginLines = OutLines;
+        Process(*included, depth + 1);
+
+        // A file of directives only, like one defining macros, would leave a line for each
+        if (out.find_first_not_of('\n', begin) == std::string::npos) {
+            out.resize(begin);
+            OutLines = beginLines;
+        }
+
+        if (topLevel && out.size() != begin) {
+            TopLevelIncludes.push_back({ included->Path, begin, out.size(), RegionSource.Digest() });
+        }
+    }
+
+    bool Preprocessor::Evaluate(PPToken const* tokens, size_t count, uint32_t line) {
+        // defined X and defined(X) are resolved before anything is expanded
+        std::vector<PPToken> resolved;
+        resolved.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (tokens[i].Text != "defined") {
+                resolved.push_back(tokens[i]);
+                continue;
+            }
+
+            const bool parens = i + 1 < count && tokens[i + 1].Text == "(";
+            const size_t macro = i + (parens ? 2 : 1);
+            if (macro >= count || tokens[macro].Type != PPToken::Kind::Identifier || (parens && (macro + 1 >= count || tokens[macro + 1].Text != ")"))) {
+                Fail(line, "'defined' expects a macro name");
+            }
+
+            PPToken value = tokens[i];
+            value.Type = PPToken::Kind::Number;
+            value.Text = Macros.find(tokens[macro].Text) != Macros.end() ? "1" : "0";
+            resolved.push_back(value);
+            i = parens ? macro + 1 : macro;
+        }
+
+        std::vector<PPToken> expanded;
+        ExpandAll(resolved, expanded);
+        if (expanded.empty()) {
+            Fail(line, "#if with no expression");
+        }
+
+        try {
+            return ConditionEvaluator(expanded).Evaluate() != 0;
+        }
+        catch (std::runtime_error const& ex) {
+            Fail(line, std::string("invalid #if expression: ") + ex.what());
+        }
+    }
+
+    void Preprocessor::ExpandAll(std::vector<PPToken> const& tokens, std::vector<PPToken>& out) {
+        if (Macros.empty()) {
+            out.insert(out.end(), tokens.begin(), tokens.end());
+            return;
+        }
+
+        // Reversed, so the next token is at the back and expansions are pushed in front of the rest cheaply
+        std::vector<PPToken> stack(tokens.rbegin(), tokens.rend());
+        while (!stack.empty()) {
+            const PPToken token = stack.back();
+            stack.pop_back();
+
+            if (token.Type == PPToken::Kind::Identifier && TryExpand(token, stack)) continue;
+            out.push_back(token);
+        }
+    }
+
+    bool Preprocessor::TryExpand(PPToken const& name, std::vector<PPToken>& stack) {
+        auto it = Macros.find(name.Text);
+        if (it == Macros.end()) return false;
+
+        // A macro is never expanded again inside its own expansion
+        for (HideSet const* hidden = name.Hidden; hidden; hidden = hidden->Next) {
+            if (hidden->Name == name.Text) return false;
+        }
+
+        Macro const& macro = it->second;
+        std::vector<PPToken> body;
+        HideSet const* hidden = nullptr;
+
+        if (!macro.FunctionLike) {
+            hidden = Hide(name.Hidden, name.Text);
+            body = Substitute(macro, { });
+        } else {
+            // The name of a function-like macro without arguments is left alone
+            if (stack.empty() || stack.back().Text != "(") return false;
+            stack.pop_back();
+
+            PPToken rparen;
+            const auto args = ReadArguments(name, macro, stack, rparen);
+            hidden = Hide(Intersect(name.Hidden, rparen.Hidden), name.Text);
+            body = Substitute(macro, args);
+        }
+
+        for (auto& token : body) {
+            token.Hidden = Union(token.Hidden, hidden);
+            token.Line = name.Line;
+            token.LineStart = false;
+        }
+        if (!body.empty()) {
+            body.front().Space = name.Space;
+            body.front().LineStart = name.LineStart;
+        } else if (name.LineStart && !stack.empty() && !stack.back().LineStart) {
+            // What follows a call expanding to nothing starts the line in its place, instead of joining the one before
+            stack.back().LineStart = true;
+            stack.back().Line = name.Line;
+        }
+
+        // The expansion is rescanned together with the rest, which is how nested and chained macros expand
+        stack.insert(stack.end(), body.rbegin(), body.rend());
+        return true;
+    }
+
+    std::vector<std::vector<PPToken>> Preprocessor::ReadArguments(PPToken const& name, Macro const& macro, std::vector<PPToken>& stack, PPToken& rparen) {
+        std::vector<std::vector<PPToken>> args(1);
+        int depth = 0;
+
+        for (;;) {
+            if (stack.empty()) {
+                Fail(name.Line, "unterminated call to macro '" + std::string(name.Text) + "'");
+            }
+
+            const PPToken token = stack.back();
+            stack.pop_back();
+
+            if (depth == 0 && token.Text == ")") {
+                rparen = token;
+                break;
+            }
+            // Past the named parameters, commas belong to __VA_ARGS__
+            if (depth == 0 && token.Text == "," && !(macro.Variadic && args.size() == macro.Params.size())) {
+                args.emplace_back();
+                continue;
+            }
+
+            if (token.Text == "(") {
+                ++depth;
+            } else if (token.Text == ")") {
+                --depth;
+            }
+            args.back().push_back(token);
+        }
+
+        if (macro.Params.empty() && args.size() == 1 && args[0].empty()) {
+            args.clear();
+        }
+        // f(a) for f(x, ...) leaves __VA_ARGS__ empty
+        if (macro.Variadic && args.size() + 1 == macro.Params.size()) {
+            args.emplace_back();
+        }
+
+        if (args.size() != macro.Params.size()) {
+            Fail(name.Line, "macro '" + std::string(name.Text) + "' takes " + std::to_string(macro.Params.size()) +
+                " arguments, but was given " + std::to_string(args.size()));
+        }
+        return args;
+    }
+
+    std::vector<PPToken> Preprocessor::Substitute(Macro const& macro, std::vector<std::vector<PPToken>> const& args) {
+        auto parameter = [&](PPToken const& token) -> int {
+            if (token.Type != PPToken::Kind::Identifier) return -1;
+            for (size_t p = 0; p < macro.Params.size(); ++p) {
+                if (macro.Params[p] == token.Text) return static_cast<int>(p);
+            }
+            return -1;
+        };
+
+        auto const& body = macro.Body;
+        std::vector<PPToken> out;
+        std::vector<PPToken> expanded;
+
+        // Set when the left operand of ## was an empty argument, which leaves nothing to paste onto
+        bool placemarker = false;
+
+        for (size_t i = 0; i < body.size(); ++i) {
+            PPToken const& token = body[i];
+
+            if (token.Text == "#" && i + 1 < body.size() && parameter(body[i + 1]) >= 0) {
+                PPToken string = Stringize(args[parameter(body[i + 1])]);
+                string.Space = token.Space;
+                out.push_back(string);
+                placemarker = false;
+                ++i;
+                continue;
+            }
+
+            if (token.Text == "##") {
+                PPToken const& right = body[++i];
+                const int p = parameter(right);
+                const std::vector<PPToken> operand = p >= 0 ? args[p] : std::vector<PPToken> { right };
+                if (operand.empty()) continue;
+
+                size_t first = 0;
+                if (!placemarker && !out.empty()) {
+                    out.back() = Paste(out.back(), operand[0]);
+                    first = 1;
+                }
+                out.insert(out.end(), operand.begin() + first, operand.end());
+                placemarker = false;
+                continue;
+            }
+
+            placemarker = false;
+
+            const int p = parameter(token);
+            if (p < 0) {
+                out.push_back(token);
+                continue;
+            }
+
+            // Operands of ## are used as written, other arguments are fully expanded first
+            const bool pasted = i + 1 < body.size() && body[i + 1].Text == "##";
+            std::vector<PPToken> const* arg = &args[p];
+            if (!pasted) {
+                expanded.clear();
+                ExpandAll(args[p], expanded);
+                arg = &expanded;
+            }
+
+            placemarker = pasted && arg->empty();
+            if (!arg->empty()) {
+                const size_t start = out.size();
+                out.insert(out.end(), arg->begin(), arg->end());
+                out[start].Space = token.Space;
+            }
+        }
+
+        return out;
+    }
+
+    PPToken Preprocessor::Paste(PPToken const& left, PPToken const& right) {
+        const std::string_view text = Store(std::string(left.Text) + std::string(right.Text));
+
+        PPToken token = left;
+        token.Text = text;
+        if (Lex(text, token.Type) != text.size()) {
+            Fail(left.Line, "pasting '" + std::string(left.Text) + "' and '" + std::string(right.Text) + "' does not give a valid token");
+        }
+        return token;
+    }
+
+    PPToken Preprocessor::Stringize(std::vector<PPToken> const& arg) {
+        std::string text = "\"";
+        for (size_t i = 0; i < arg.size(); ++i) {
+            if (i != 0 && (arg[i].Space || arg[i].LineStart)) {
+                text += ' ';
+            }
+
+            if (arg[i].Type == PPToken::Kind::String) {
+                for (char c : arg[i].Text) {
+                    if (c == '"' || c == '\\') text += '\\';
+                    text += c;
+                }
+            } else {
+                text += arg[i].Text;
+            }
+        }
+        text += '"';
+
+        PPToken token;
+        token.Text = Store(std::move(text));
+        token.Type = PPToken::Kind::String;
+        return token;
+    }
+
+    HideSet const* Preprocessor::Hide(HideSet const* set, std::string_view name) {
+        HideSets.push_back(HideSet { name, set });
+        return &HideSets.back();
+    }
+
+    HideSet const* Preprocessor::Union(HideSet const* a, HideSet const* b) {
+        if (!a) return b;
+        if (!b) return a;
+
+        HideSet const* result = b;
+        for (; a; a = a->Next) {
+            bool present = false;
+            for (HideSet const* it = b; it && !present; it = it->Next) {
+                present = it->Name == a->Name;
+            }
+            if (!present) result = Hide(result, a->Name);
+        }
+        return result;
+    }
+
+    HideSet const* Preprocessor::Intersect(HideSet const* a, HideSet const* b) {
+        HideSet const* result = nullptr;
+        for (; a; a = a->Next) {
+            for (HideSet const* it = b; it; it = it->Next) {
+                if (it->Name == a->Name) {
+                    result = Hide(result, a->Name);
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    void Preprocessor::Emit(std::vector<PPToken> const& tokens, size_t lineOffset) {
+        std::string& out = *Out;
+        for (auto const& token : tokens) {
+            const bool word = token.Type == PPToken::Kind::Identifier || token.Type == PPToken::Kind::Number;
+
+            // The first token of a line goes on that line, unless a macro call spanning lines still writes to an earlier one
+            if (token.LineStart && OutLines < lineOffset + token.Line - 1) {
+                EndLines(lineOffset + token.Line - 1);
+            }
+
+            const bool lineOpen = !out.empty() && out.back() != '\n';
+            if (lineOpen) {
+                // Tokens that came out of different places must not run together into a different token
+                bool separate = token.Space || token.LineStart || (word && LastWasWord);
+                if (!separate && token.Type == PPToken::Kind::Punctuator && std::ispunct(static_cast<unsigned char>(out.back()))) {
+                    const char pair[2] = { out.back(), token.Text[0] };
+                    separate = PunctuatorLength(std::string_view(pair, 2)) == 2;
+                }
+                if (separate) out += ' ';
+            }
+
+            out += token.Text;
+            LastWasWord = word;
+        }
+    }
+
+    void Preprocessor::EndLines(size_t lines) {
+        std::string& out = *Out;
+        if (!out.empty() && out.back() != '\n') {
+            out += '\n';
+            ++OutLines;
+        }
+        for (; OutLines < lines; ++OutLines) {
+            out += '\n';
+        }
+    }
+
+    std::string_view Preprocessor::Store(std::string text) {
+        Strings.push_back(std::move(text));
+        return Strings.back();
+    }
+
+    void Preprocessor::Fail(uint32_t line, std::string const& message) const {
+        const std::string file = CurrentFile ? CurrentFile->Path.string() : std::string();
+        throw std::runtime_error(file + "(" + std::to_string(line) + "): " + message);
+    }
+
+    std::string WithoutRegions(std::string_view out, std::vector<Preprocessor::IncludedRegion> const& regions) {
+        std::string own;
+        size_t from = 0;
+        for (auto const& region : regions) {
+            own.append(out, from, region.Begin - from);
+            own += '\n';
+            from = region.End;
+        }
+        own.append(out, from, std::string_view::npos);
+        return own;
+    }
+}
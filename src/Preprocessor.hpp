@@ -0,0 +1,188 @@
+#pragma once
+
+#include <set>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <string_view>
+#include <filesystem>
+#include <unordered_map>
+
+#include "Cache.hpp"
+
+namespace ReflectHLSL {
+    // Macros defined before the shader's first line, like -D on a compiler command line
+    struct DefinesContext {
+        std::vector<std::pair<std::string, std::string>> Defines;
+
+        void Define(std::string name, std::string value = "1") {
+            Defines.emplace_back(std::move(name), std::move(value));
+        }
+    };
+
+    // Names of the macros a token was expanded from. Tails are shared; the Preprocessor owns the nodes.
+    struct HideSet {
+        std::string_view Name;
+        HideSet const* Next = nullptr;
+    };
+
+    struct PPToken {
+        enum class Kind : uint8_t { Identifier, Number, String, Punctuator, Other };
+
+        std::string_view Text;
+        // Macros it must not expand again
+        HideSet const* Hidden = nullptr;
+        uint32_t Line = 0;
+        Kind Type = Kind::Other;
+        // Whitespace before it, and whether it is the first token of its line
+        bool Space = false;
+        bool LineStart = false;
+    };
+
+    // A source file split into preprocessing tokens, with comments removed and continued lines
+    // joined. Immutable once built, so one copy serves every file that includes it.
+    struct SourceFile {
+        struct Line {
+            uint32_t First = 0;
+            uint32_t Count = 0;
+            uint32_t Number = 0;
+            bool Directive = false;
+        };
+
+        std::filesystem::path Path;
+        // Tokens point into Text
+        std::string Text;
+        std::vector<PPToken> Tokens;
+        // Only lines with tokens on them
+        std::vector<Line> Lines;
+        // The macro of an #ifndef/#endif pair wrapping the whole file, if there is one
+        std::string Guard;
+        // Of Text, so edits that only touch comments keep it
+        uint64_t Hash = 0;
+
+        static std::shared_ptr<SourceFile const> Tokenize(std::filesystem::path path, std::string_view text);
+    };
+
+    // Files read through #include, tokenized once and shared by every shader of a run.
+    // Safe to use from several threads.
+    class IncludeCache {
+    public:
+        // Throws if the file can't be read
+        std::shared_ptr<SourceFile const> Load(std::filesystem::path const& path);
+
+        // Forget every file, so edits made since are seen
+        void Clear();
+
+        size_t Size() const;
+
+    private:
+        mutable std::mutex Mutex;
+        std::unordered_map<std::string, std::shared_ptr<SourceFile const>> Files;
+    };
+
+    // Expands one shader: object- and function-like macros (with #, ## and __VA_ARGS__),
+    // #if/#ifdef/#ifndef/#elif/#else/#endif, #include with search paths and #pragma once.
+    // The output holds no directives and no comments, one source line per line: directives, skipped branches and
+    // comments leave their lines empty, and a macro call spanning lines is expanded on its first line, followed by
+    // empty lines. An #include is replaced by the lines of the file, or by an empty line if it expands to nothing.
+    class Preprocessor {
+    public:
+        Preprocessor(IncludeCache& includes, std::vector<std::filesystem::path> const& includeDirs, DefinesContext const& defines);
+        ~Preprocessor();
+
+        Preprocessor(Preprocessor const&) = delete;
+        Preprocessor& operator=(Preprocessor const&) = delete;
+
+        // Appends the expansion of source, the text of path, to out.
+        // Throws std::runtime_error naming the file and line on errors.
+        void Run(std::filesystem::path const& path, std::string_view source, std::string& out);
+
+        // Every file read through #include, in the order they were first included
+        std::vector<std::filesystem::path> const& Includes() const { return IncludedFiles; }
+
+        // The output of an #include written in the shader itself, with everything it includes in turn.
+        // Whole lines of the output, from Begin up to End.
+        struct IncludedRegion {
+            std::filesystem::path Path;
+            size_t Begin = 0;
+            size_t End = 0;
+            // Of the text of every file read for it
+            uint64_t SourceHash = 0;
+        };
+
+        // Regions of the output, in order. Includes that expand to nothing have none.
+        std::vector<IncludedRegion> const& Regions() const { return TopLevelIncludes; }
+
+    private:
+        struct Macro {
+            std::vector<PPToken> Body;
+            std::vector<std::string_view> Params;
+            bool FunctionLike = false;
+            bool Variadic = false;
+        };
+
+        struct Conditional {
+            bool ParentActive = true;
+            bool Active = false;
+            bool Taken = false;
+            bool SeenElse = false;
+        };
+
+        struct NameHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+        };
+
+        void Process(SourceFile const& file, size_t depth);
+        void Directive(SourceFile const& file, SourceFile::Line const& line, std::vector<Conditional>& conditionals, size_t depth);
+        void Define(PPToken const* tokens, size_t count, uint32_t line);
+        void Include(SourceFile const& file, PPToken const* tokens, size_t count, uint32_t line, size_t depth);
+        bool Evaluate(PPToken const* tokens, size_t count, uint32_t line);
+
+        void ExpandAll(std::vector<PPToken> const& tokens, std::vector<PPToken>& out);
+        bool TryExpand(PPToken const& name, std::vector<PPToken>& stack);
+        std::vector<std::vector<PPToken>> ReadArguments(PPToken const& name, Macro const& macro, std::vector<PPToken>& stack, PPToken& rparen);
+        std::vector<PPToken> Substitute(Macro const& macro, std::vector<std::vector<PPToken>> const& args);
+        PPToken Paste(PPToken const& left, PPToken const& right);
+        PPToken Stringize(std::vector<PPToken> const& arg);
+
+        HideSet const* Hide(HideSet const* set, std::string_view name);
+        HideSet const* Union(HideSet const* a, HideSet const* b);
+        HideSet const* Intersect(HideSet const* a, HideSet const* b);
+
+        void Emit(std::vector<PPToken> const& tokens, size_t lineOffset);
+        void EndLines(size_t lines);
+        std::string_view Store(std::string text);
+        [[noreturn]] void Fail(uint32_t line, std::string const& message) const;
+
+        IncludeCache& Cache;
+        std::vector<std::filesystem::path> const& IncludeDirs;
+        DefinesContext const& Defines;
+
+        std::unordered_map<std::string, Macro, NameHash, std::equal_to<>> Macros;
+        std::vector<std::shared_ptr<SourceFile const>> Files;
+        std::vector<std::filesystem::path> IncludedFiles;
+        std::vector<IncludedRegion> TopLevelIncludes;
+        // Combines the hashes of the files read for the region being written
+        Hasher RegionSource;
+        std::set<std::string, std::less<>> Once;
+        std::deque<HideSet> HideSets;
+        std::deque<std::string> Strings;
+
+        SourceFile const* CurrentFile = nullptr;
+        std::string* Out = nullptr;
+        // Newlines written to Out by this run
+        size_t OutLines = 0;
+        // Identifiers and numbers written back to back need a space between them
+        bool LastWasWord = false;
+    };
+
+    // The output of a Preprocessor without the regions of its includes, each replaced by the empty line of its #include,
+    // so the shader's own lines keep their numbers
+    std::string WithoutRegions(std::string_view out, std::vector<Preprocessor::IncludedRegion> const& regions);
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+// Included inside a namespace, the std headers below would be declared in it and break. Ahead of them, this fails
+// first and says why: a translation unit including generated files inside namespaces includes this header at global
+// scope before them.
+namespace ReflectHLSL { inline constexpr bool IncludedAtGlobalScope = true; }
+static_assert(::ReflectHLSL::IncludedAtGlobalScope, "Include ReflectHLSLRuntime.hpp at global scope before generated files included inside namespaces");
+
+#include <new>
+#include <array>
+#include <tuple>
+#include <memory>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+// Types generated code refers to as ::ReflectHLSL::..., shared by every generated file. Include this at global scope
+// before including generated files inside namespaces of their own, so all of them see the same declarations.
+namespace ReflectHLSL {
+    // A data member of a generated struct, as listed in the struct's Members
+    struct ReflectedMember {
+        static constexpr uint32_t Unknown = ~0u;
+
+        const char* Name;
+        const char* Type;        // HLSL type of one element
+        uint32_t Offset;         // Bytes from the start of the struct, Unknown if it has no GPU layout
+        uint32_t Size;           // Bytes of all its elements, or Unknown
+        uint32_t Rank;           // Array dimensions, 0 if it isn't an array
+        uint32_t Dimensions[4];  // Element count of each of the first four
+        const char* Semantic;    // Empty if it has none
+    };
+
+    // An explicit register(...) of a cbuffer or resource, as listed in a Program's Bindings
+    struct ReflectedBinding {
+        enum RegisterClass : uint8_t {
+            ConstantBuffer,   // b
+            ShaderResource,   // t
+            UnorderedAccess,  // u
+            Sampler,          // s
+        };
+
+        const char* Name = "";
+        RegisterClass Class = ShaderResource;
+        uint32_t Slot = 0;
+        uint32_t Space = 0;
+        uint32_t Count = 1;  // Descriptors, more than one for arrays
+    };
+
+    // The Bindings of a Program: those of the shared headers it derives from, then its own
+    template<size_t... Sizes>
+    constexpr std::array<ReflectedBinding, (Sizes + ... + 0)> JoinBindings(std::array<ReflectedBinding, Sizes> const&... tables) {
+        std::array<ReflectedBinding, (Sizes + ... + 0)> all = { };
+        size_t next = 0;
+        ((std::copy(tables.begin(), tables.end(), all.begin() + next), next += Sizes), ...);
+        return all;
+    }
+
+    // Memory of a structure of arrays: a column of Capacity() elements of each type, one block for all of them.
+    // Every column starts and ends on an Alignment boundary, so loops over columns vectorize with aligned loads
+    // and no scalar tail at any SIMD width up to 512 bits.
+    template<typename... Columns>
+    class ColumnStorage {
+    public:
+        static constexpr size_t Alignment = 64;
+
+        ColumnStorage() = default;
+        explicit ColumnStorage(size_t count) { Resize(count); }
+
+        size_t Size() const { return Count; }
+        // Rows allocated, a multiple of Alignment
+        size_t Capacity() const { return Rows; }
+
+        // Keeps the first rows. Rows added are uninitialized.
+        void Resize(size_t count) {
+            if (count > Rows) {
+                const size_t rows = (count + Alignment - 1) / Alignment * Alignment;
+                Block memory(static_cast<std::byte*>(::operator new(rows * RowSize, std::align_val_t(Alignment))));
+                for (size_t i = 0; i < sizeof...(Columns); ++i) {
+                    if (Count != 0) std::memcpy(memory.get() + rows * Starts[i], Memory.get() + Rows * Starts[i], Count * Sizes[i]);
+                }
+                Memory = std::move(memory);
+                Rows = rows;
+            }
+            Count = count;
+        }
+
+    protected:
+        template<size_t I>
+        using Column = std::tuple_element_t<I, std::tuple<Columns...>>;
+
+        template<size_t I>
+        Column<I>* Get() { return reinterpret_cast<Column<I>*>(Memory.get() + Rows * Starts[I]); }
+        template<size_t I>
+        Column<I> const* Get() const { return reinterpret_cast<Column<I> const*>(Memory.get() + Rows * Starts[I]); }
+
+        // Writes rows [first, first + count) to destination in order, Stride bytes each, with column i at Offsets[i].
+        // Whole rows are assembled before they're written, padding zeroed, so the destination is written
+        // sequentially, which write combined upload memory needs to be fast.
+        template<size_t Stride, size_t... Offsets>
+        void PackRows(void* destination, size_t first, size_t count) const {
+            static_assert(sizeof...(Offsets) == sizeof...(Columns));
+            PackRows<Stride, Offsets...>(static_cast<std::byte*>(destination), first, count, std::index_sequence_for<Columns...>());
+        }
+
+    private:
+        struct Free {
+            void operator()(std::byte* memory) const { ::operator delete(memory, std::align_val_t(Alignment)); }
+        };
+        using Block = std::unique_ptr<std::byte, Free>;
+
+        static constexpr size_t Sizes[] = { sizeof(Columns)..., 0 };
+        static constexpr size_t RowSize = (sizeof(Columns) + ... + 0);
+        // Bytes of the columns before each per row, so column i starts at Rows * Starts[i]
+        static constexpr auto Starts = []() {
+            std::array<size_t, sizeof...(Columns) + 1> starts = { };
+            for (size_t i = 0; i < sizeof...(Columns); ++i) starts[i + 1] = starts[i] + Sizes[i];
+            return starts;
+        }();
+
+        template<size_t Stride, size_t... Offsets, size_t... I>
+        void PackRows(std::byte* destination, size_t first, size_t count, std::index_sequence<I...>) const {
+            const std::tuple<Columns const*...> columns { (Get<I>() + first)... };
+            for (size_t row = 0; row < count; ++row, destination += Stride) {
+                alignas(Alignment) std::byte packed[Stride] = { };
+                (std::memcpy(packed + Offsets, std::get<I>(columns) + row, sizeof(Columns)), ...);
+                std::memcpy(destination, packed, Stride);
+            }
+        }
+
+        Block Memory;
+        size_t Count = 0;
+        size_t Rows = 0;
+    };
+
+    // Byte ranges of a CPU copy of GPU data changed since they were last uploaded. Flush coalesces them into
+    // the fewest regions covering every changed byte, so a frame uploads only what changed.
+    class DirtyRanges {
+    public:
+        void Mark(size_t offset, size_t size) {
+            // Changes in ascending order, the common case, extend the last range
+            if (!Ranges.empty() && offset >= Ranges.back().Begin && offset <= Ranges.back().End) {
+                Ranges.back().End = std::max(Ranges.back().End, offset + size);
+                return;
+            }
+            // The same fields changing again and again between flushes don't grow the list
+            if (Ranges.size() >= CoalesceAt && Ranges.size() == Ranges.capacity()) Coalesce(1, ~size_t(0));
+            Ranges.push_back({ offset, offset + size });
+        }
+
+        void MarkAll(size_t size) { Ranges.assign(1, { 0, size }); }
+        bool Empty() const { return Ranges.empty(); }
+        void Clear() { Ranges.clear(); }
+
+        // Calls upload(offset, size) for each region to upload, in ascending order, and returns the bytes they cover.
+        // Ranges are widened to multiples of alignment, such as Vulkan's nonCoherentAtomSize, but not past limit,
+        // then merged where they overlap or touch.
+        template<typename Upload>
+        size_t Flush(Upload&& upload, size_t alignment = 1, size_t limit = ~size_t(0)) {
+            Coalesce(alignment, limit);
+            size_t bytes = 0;
+            for (Range const& range : Ranges) {
+                upload(range.Begin, range.End - range.Begin);
+                bytes += range.End - range.Begin;
+            }
+            Ranges.clear();
+            return bytes;
+        }
+
+    private:
+        struct Range {
+            size_t Begin;
+            size_t End;
+        };
+        static constexpr size_t CoalesceAt = 64;
+
+        void Coalesce(size_t alignment, size_t limit) {
+            for (Range& range : Ranges) {
+                range.Begin = range.Begin / alignment * alignment;
+                range.End = std::min((range.End + alignment - 1) / alignment * alignment, std::max(limit, range.End));
+            }
+            std::sort(Ranges.begin(), Ranges.end(), [](Range const& a, Range const& b) { return a.Begin < b.Begin; });
+
+            size_t merged = 0;
+            for (size_t i = 1; i < Ranges.size(); ++i) {
+                if (Ranges[i].Begin <= Ranges[merged].End) {
+                    Ranges[merged].End = std::max(Ranges[merged].End, Ranges[i].End);
+                } else {
+                    Ranges[++merged] = Ranges[i];
+                }
+            }
+            if (!Ranges.empty()) Ranges.resize(merged + 1);
+        }
+
+        std::vector<Range> Ranges;
+    };
+
+    // The elements of a StructuredBuffer kept on the CPU, recording which change so only those are uploaded.
+    // Elements are generated structs, whose size is their stride in the GPU layout.
+    template<typename T>
+    class TrackedElements {
+    public:
+        TrackedElements() = default;
+        explicit TrackedElements(size_t count) { Resize(count); }
+
+        size_t Size() const { return Elements.size(); }
+        T const& operator[](size_t index) const {
+            assert(index < Elements.size() && "element index out of range");
+            return Elements[index];
+        }
+        T const* Data() const { return Elements.data(); }
+
+        void Set(size_t index, T const& value) {
+            assert(index < Elements.size() && "element index out of range");
+            Elements[index] = value;
+            Dirty.Mark(index * sizeof(T), sizeof(T));
+        }
+
+        // The element to change in place, marked as changed
+        T& Edit(size_t index) {
+            assert(index < Elements.size() && "element index out of range");
+            Dirty.Mark(index * sizeof(T), sizeof(T));
+            return Elements[index];
+        }
+
+        // Marks every element changed, since a resized buffer is uploaded whole
+        void Resize(size_t count) {
+            Elements.resize(count);
+            Dirty.MarkAll(count * sizeof(T));
+        }
+
+        // Calls upload(offset, source, size) for each region of changed bytes, see DirtyRanges::Flush
+        template<typename Upload>
+        size_t Flush(Upload&& upload, size_t alignment = 1) {
+            const std::byte* bytes = reinterpret_cast<const std::byte*>(Elements.data());
+            return Dirty.Flush([&](size_t offset, size_t size) { upload(offset, bytes + offset, size); }, alignment, Elements.size() * sizeof(T));
+        }
+
+        // Copies the changed bytes to the same offsets of destination, the buffer's mapped memory
+        size_t FlushTo(void* destination, size_t alignment = 1) {
+            return Flush([&](size_t offset, const void* source, size_t size) { std::memcpy(static_cast<std::byte*>(destination) + offset, source, size); }, alignment);
+        }
+
+    private:
+        std::vector<T> Elements;
+        DirtyRanges Dirty;
+    };
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ReflectHLSL {
+    // Fixed set of workers, each owning a deque of task indices. A worker pops
+    // from the back of its own deque and steals from the front of the others
+    // once it runs dry, so a few slow files don't leave the other cores idle.
+    class ThreadPool {
+    public:
+        using Task = std::function<void(size_t index, size_t worker)>;
+
+        // A pool of 0 or 1 threads runs everything inline on the caller
+        explicit ThreadPool(size_t threadCount) {
+            if (threadCount <= 1) return;
+
+            for (size_t i = 0; i < threadCount; ++i) {
+                Queues.push_back(std::make_unique<Queue>());
+            }
+            for (size_t i = 0; i < threadCount; ++i) {
+                Threads.emplace_back([this, i]() { WorkerLoop(i); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Stopping = true;
+            }
+            WorkReady.notify_all();
+            for (auto& thread : Threads) {
+                thread.join();
+            }
+        }
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        inline size_t Size() const {
+            return Threads.empty() ? 1 : Threads.size();
+        }
+
+        static inline size_t HardwareThreads() {
+            const size_t count = std::thread::hardware_concurrency();
+            return count == 0 ? 1 : count;
+        }
+
+        // Runs task(i, worker) for every i in [0, count) and blocks until all of
+        // them finished. The first exception thrown by a task is rethrown here.
+        //
+        // Callers on different threads take turns, since the workers run one
+        // batch at a time. A task calling ParallelFor on the pool running it
+        // gets the nested batch run inline on its own worker, which would
+        // otherwise wait forever on itself.
+        void ParallelFor(size_t count, Task const& task) {
+            if (count == 0) return;
+
+            if (Threads.empty() || RunningPool == this) {
+                const size_t worker = Threads.empty() ? 0 : RunningWorker;
+                for (size_t i = 0; i < count; ++i) {
+                    task(i, worker);
+                }
+                return;
+            }
+
+            std::lock_guard<std::mutex> caller(CallerMutex);
+
+            for (size_t i = 0; i < count; ++i) {
+                Queue& queue = *Queues[i % Queues.size()];
+                std::lock_guard<std::mutex> lock(queue.Mutex);
+                queue.Items.push_back(i);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Current = &task;
+                Remaining = count;
+                Error = nullptr;
+                ++Generation;
+            }
+            WorkReady.notify_all();
+
+            std::exception_ptr error;
+            {
+                std::unique_lock<std::mutex> lock(Mutex);
+                // Wait for the workers to go idle too, so none of them can pick up the next batch with this task
+                WorkDone.wait(lock, [this]() { return Remaining.load() == 0 && ActiveWorkers == 0; });
+                Current = nullptr;
+                error = Error;
+            }
+
+            if (error) std::rethrow_exception(error);
+        }
+
+    private:
+        struct Queue {
+            std::mutex Mutex;
+            std::deque<size_t> Items;
+        };
+
+        bool Pop(size_t worker, size_t& index) {
+            {
+                Queue& own = *Queues[worker];
+                std::lock_guard<std::mutex> lock(own.Mutex);
+                if (!own.Items.empty()) {
+                    index = own.Items.back();
+                    own.Items.pop_back();
+                    return true;
+                }
+            }
+
+            for (size_t i = 1; i < Queues.size(); ++i) {
+                Queue& victim = *Queues[(worker + i) % Queues.size()];
+                std::lock_guard<std::mutex> lock(victim.Mutex);
+                if (!victim.Items.empty()) {
+                    index = victim.Items.front();
+                    victim.Items.pop_front();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void WorkerLoop(size_t worker) {
+            RunningPool = this;
+            RunningWorker = worker;
+            size_t seenGeneration = 0;
+
+            for (;;) {
+                Task const* task = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(Mutex);
+                    WorkReady.wait(lock, [&]() { return Stopping || Generation != seenGeneration; });
+                    if (Stopping) return;
+                    seenGeneration = Generation;
+                    task = Current;
+                    if (!task) continue;
+                    ++ActiveWorkers;
+                }
+
+                size_t index;
+                while (Pop(worker, index)) {
+                    try {
+                        (*task)(index, worker);
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(Mutex);
+                        if (!Error) Error = std::current_exception();
+                    }
+
+                    Remaining.fetch_sub(1);
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(Mutex);
+                    --ActiveWorkers;
+                }
+                WorkDone.notify_all();
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> Queues;
+        std::vector<std::thread> Threads;
+
+        // Held by the caller whose batch the workers are running
+        std::mutex CallerMutex;
+
+        // The pool and worker index of the calling thread, if it is a worker
+        static inline thread_local ThreadPool const* RunningPool = nullptr;
+        static inline thread_local size_t RunningWorker = 0;
+
+        std::mutex Mutex;
+        std::condition_variable WorkReady;
+        std::condition_variable WorkDone;
+        Task const* Current = nullptr;
+        size_t Generation = 0;
+        std::atomic<size_t> Remaining = 0;
+        size_t ActiveWorkers = 0;
+        std::exception_ptr Error;
+        bool Stopping = false;
+    };
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <filesystem>
+
+#include "Generator.hpp"
+
+// Entry points of the command line tool, implemented in HLSL.cpp
+
+// The file this process runs from, found through the OS, or argv0 where it can't be
+std::filesystem::path ExecutablePath(const char* argv0);
+
+// .vert, .frag and .comp files
+bool IsShaderSource(std::filesystem::path const& path);
+
+// .hlsli, .hlsl, .fxh and .h files, which shaders #include
+bool IsShaderInclude(std::filesystem::path const& path);
+
+int ProcessFile(std::filesystem::path input, std::ostream& out, std::ostream& err, std::filesystem::path output = "");
+
+int ProcessFiles(std::vector<std::filesystem::path> const& files, size_t jobs);
+
+int ScanDir(std::filesystem::path scanDirectory, size_t jobs);
+
+// Generates every permutation listed in specPath, parsing the declarations all permutations of a shader share once
+int ProcessPermutations(std::filesystem::path specPath, size_t jobs);
+
+// Write the content-hash cache back to disk if it changed
+void SaveBuildCache();
+
+// Scans once, then regenerates outputs as sources and their .spv files change. Implemented in Watch.cpp
+int WatchDir(std::filesystem::path watchDirectory, size_t jobs);
@@ -0,0 +1,633 @@
+#include <set>
+#include <map>
+#include <cctype>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "Translate.hpp"
+#include "Layout.hpp"
+
+namespace ReflectHLSL {
+    static bool IsIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static bool IsIdentifierChar(char c) {
+        return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+    }
+
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    // Index just past the bracket closing the one at open, or npos if it isn't closed
+    static size_t SkipBalanced(std::string_view text, size_t open, char opening, char closing) {
+        size_t depth = 0;
+        for (size_t i = open; i < text.size(); ++i) {
+            if (text[i] == opening) {
+                ++depth;
+            } else if (text[i] == closing && --depth == 0) {
+                return i + 1;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    static size_t SkipSpace(std::string_view text, size_t i) {
+        while (i < text.size() && IsSpace(text[i])) ++i;
+        return i;
+    }
+
+    std::string_view FindFunctionBody(std::string_view source, std::string_view name) {
+        size_t depth = 0;
+        for (size_t i = 0; i < source.size(); ++i) {
+            const char c = source[i];
+            if (c == '{') ++depth;
+            else if (c == '}' && depth > 0) --depth;
+            if (depth != 0 || !IsIdentifierStart(c) || (i > 0 && IsIdentifierChar(source[i - 1]))) continue;
+
+            size_t end = i;
+            while (end < source.size() && IsIdentifierChar(source[end])) ++end;
+            if (source.substr(i, end - i) != name) {
+                i = end - 1;
+                continue;
+            }
+
+            size_t next = SkipSpace(source, end);
+            if (next >= source.size() || source[next] != '(') continue;
+            next = SkipBalanced(source, next, '(', ')');
+            if (next == std::string_view::npos) return { };
+
+            // The return value's semantic, like : SV_Target
+            next = SkipSpace(source, next);
+            if (next < source.size() && source[next] == ':') {
+                next = SkipSpace(source, next + 1);
+                while (next < source.size() && IsIdentifierChar(source[next])) ++next;
+                next = SkipSpace(source, next);
+            }
+
+            if (next >= source.size() || source[next] != '{') continue;
+            const size_t close = SkipBalanced(source, next, '{', '}');
+            if (close == std::string_view::npos) return { };
+            return source.substr(next + 1, close - next - 2);
+        }
+        return { };
+    }
+
+    struct BodyToken {
+        enum class Kind : uint8_t { Identifier, Number, Space, Punctuator };
+
+        std::string_view Text;
+        Kind Type = Kind::Punctuator;
+    };
+
+    static std::vector<BodyToken> TokenizeBody(std::string_view body) {
+        std::vector<BodyToken> tokens;
+        size_t i = 0;
+        while (i < body.size()) {
+            const size_t start = i;
+            const char c = body[i];
+            BodyToken::Kind kind = BodyToken::Kind::Punctuator;
+
+            if (IsSpace(c)) {
+                while (i < body.size() && IsSpace(body[i])) ++i;
+                kind = BodyToken::Kind::Space;
+            } else if (IsIdentifierStart(c)) {
+                while (i < body.size() && IsIdentifierChar(body[i])) ++i;
+                kind = BodyToken::Kind::Identifier;
+            } else if ((c >= '0' && c <= '9') || (c == '.' && i + 1 < body.size() && body[i + 1] >= '0' && body[i + 1] <= '9')) {
+                const bool hex = c == '0' && i + 1 < body.size() && (body[i + 1] == 'x' || body[i + 1] == 'X');
+                while (i < body.size() && (IsIdentifierChar(body[i]) || body[i] == '.')) {
+                    // The sign of an exponent, like 1e-3
+                    if (!hex && (body[i] == 'e' || body[i] == 'E') && i + 1 < body.size() && (body[i + 1] == '-' || body[i + 1] == '+')) ++i;
+                    ++i;
+                }
+                kind = BodyToken::Kind::Number;
+            } else {
+                ++i;
+            }
+
+            tokens.push_back({ body.substr(start, i - start), kind });
+        }
+        return tokens;
+    }
+
+    // HLSL float literals are float, C++ ones double. 1.0h is half, which the CPU computes as float.
+    static void AppendNumber(std::string_view number, std::string& out) {
+        const bool hex = number.size() > 1 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X');
+        const bool floating = !hex && number.find_first_of(".eE") != std::string_view::npos;
+        if (!floating) {
+            out += number;
+            return;
+        }
+
+        if (number.ends_with("lf") || number.ends_with("LF")) {
+            out += number.substr(0, number.size() - 2);
+        } else if (number.back() == 'h' || number.back() == 'H') {
+            out += number.substr(0, number.size() - 1);
+            out += 'f';
+        } else {
+            out += number;
+            if (number.back() != 'f' && number.back() != 'F') out += 'f';
+        }
+    }
+
+    // Intrinsics a VectorConfig implements for the CPU, such as GLMVectorConfig
+    static bool IsIntrinsic(std::string_view name) {
+        static constexpr std::string_view Intrinsics[] = {
+            "abs", "acos", "asin", "atan", "atan2", "ceil", "clamp", "cos", "cross", "distance", "dot", "exp", "exp2",
+            "floor", "frac", "length", "lerp", "log", "log2", "mad", "max", "min", "mul", "normalize", "pow", "reflect", "round",
+            "rsqrt", "saturate", "sign", "sin", "smoothstep", "sqrt", "step", "tan", "trunc",
+        };
+        return std::find(std::begin(Intrinsics), std::end(Intrinsics), name) != std::end(Intrinsics);
+    }
+
+    // Why name can't run on the CPU lane by lane, or empty if it can
+    static std::string_view Unsupported(std::string_view name, bool member) {
+        if (member) {
+            static constexpr std::string_view TextureMethods[] = {
+                "Sample", "SampleLevel", "SampleGrad", "SampleBias", "SampleCmp", "SampleCmpLevelZero", "Gather", "Load", "GetDimensions",
+            };
+            return std::find(std::begin(TextureMethods), std::end(TextureMethods), name) != std::end(TextureMethods) ? "texture access" : std::string_view();
+        }
+
+        if (name == "groupshared") return "groupshared memory";
+        if (name.ends_with("MemoryBarrier") || name.ends_with("MemoryBarrierWithGroupSync")) return "barriers";
+        if (name.starts_with("Interlocked")) return "atomics";
+        if (name.starts_with("Wave") || name.starts_with("Quad")) return "wave operations";
+        if (name == "discard" || name == "clip") return "discard";
+        return { };
+    }
+
+    // Whether a member name could be a swizzle of more than one component, like xy or rgba
+    static bool IsSwizzle(std::string_view name) {
+        return name.size() >= 2 && name.size() <= 4 &&
+            (name.find_first_not_of("xyzw") == std::string_view::npos || name.find_first_not_of("rgba") == std::string_view::npos);
+    }
+
+    static bool IsVector(std::string_view type) {
+        std::string_view component;
+        uint32_t count = 0;
+        return VectorComponents(type, component, count) && count > 1;
+    }
+
+    // The type of an element of a value of type: Light of Light[], float of float3, the row float4 of float4x4.
+    // Empty if it isn't known.
+    static std::string ElementType(std::string_view type) {
+        if (type.ends_with("[]")) return std::string(type.substr(0, type.size() - 2));
+        if (IsVector(type)) return std::string(type.substr(0, type.size() - 1));
+        if (type.size() > 3 && type[type.size() - 2] == 'x' && std::isdigit(static_cast<unsigned char>(type[type.size() - 3]))) {
+            return std::string(type.substr(0, type.size() - 2));
+        }
+        return { };
+    }
+
+    // Whether the = at tokens[i] assigns, rather than being part of ==, <=, += or the like. The compound
+    // assignments need no conversion: a vector combines with a scalar like HLSL's does.
+    static bool IsAssignment(std::vector<BodyToken> const& tokens, size_t i) {
+        static constexpr std::string_view Operators = "=!<>+-*/%&|^";
+        const bool afterOperator = i > 0 && tokens[i - 1].Text.size() == 1 && Operators.find(tokens[i - 1].Text[0]) != std::string_view::npos;
+        const bool beforeEquals = i + 1 < tokens.size() && tokens[i + 1].Text == "=";
+        return !afterOperator && !beforeEquals;
+    }
+
+    static bool IsBarrierSync(std::string_view name) {
+        return name == "GroupMemoryBarrierWithGroupSync" || name == "DeviceMemoryBarrierWithGroupSync" || name == "AllMemoryBarrierWithGroupSync";
+    }
+
+    // Names declared by the statements in tokens [first, last) outside any block, like the x of float x = 1;
+    static std::set<std::string_view> LocalDeclarations(std::vector<BodyToken> const& tokens, size_t first, size_t last) {
+        static constexpr std::string_view Keywords[] = {
+            "return", "if", "else", "for", "while", "do", "switch", "case", "default", "break", "continue",
+        };
+
+        std::set<std::string_view> names;
+        // The first tokens of the current statement, qualifiers skipped
+        std::vector<std::string_view> statement;
+        size_t depth = 0;
+        for (size_t i = first; i < last; ++i) {
+            BodyToken const& token = tokens[i];
+            if (token.Type == BodyToken::Kind::Space) continue;
+
+            if (token.Text == "{" || token.Text == "(") ++depth;
+            else if ((token.Text == "}" || token.Text == ")") && depth > 0) --depth;
+            if (depth != 0 || statement.size() > 2) {
+                if (depth == 0 && (token.Text == ";" || token.Text == "}")) statement.clear();
+                continue;
+            }
+            if (statement.empty() && (token.Text == "const" || token.Text == "static")) continue;
+
+            // A type, then the name followed by =, [, a comma or ;
+            if (statement.size() == 2 && IsIdentifierStart(statement[0][0]) && IsIdentifierStart(statement[1][0]) &&
+                std::find(std::begin(Keywords), std::end(Keywords), statement[0]) == std::end(Keywords) &&
+                (token.Text == "=" || token.Text == "[" || token.Text == "," || token.Text == ";")) {
+                names.insert(statement[1]);
+            }
+
+            if (token.Text == ";" || token.Text == "}") statement.clear();
+            else statement.push_back(token.Text);
+        }
+        return names;
+    }
+
+    bool SplitAtBarriers(std::string_view body, std::vector<std::string_view>& phases, std::string& problem) {
+        const std::vector<BodyToken> tokens = TokenizeBody(body);
+        auto offsetOf = [&](size_t token) { return token < tokens.size() ? size_t(tokens[token].Text.data() - body.data()) : body.size(); };
+
+        // Token ranges of the phases
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t first = 0;
+        size_t depth = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].Text == "{") ++depth;
+            else if (tokens[i].Text == "}" && depth > 0) --depth;
+            if (depth != 0 || !IsBarrierSync(tokens[i].Text)) continue;
+
+            // The whole statement, Barrier();
+            static constexpr std::string_view Call[] = { "(", ")", ";" };
+            size_t end = i + 1;
+            size_t matched = 0;
+            for (; end < tokens.size() && matched < std::size(Call); ++end) {
+                if (tokens[end].Type == BodyToken::Kind::Space) continue;
+                if (tokens[end].Text != Call[matched]) break;
+                ++matched;
+            }
+            if (matched != std::size(Call)) continue;
+
+            ranges.emplace_back(first, i);
+            first = end;
+            i = end - 1;
+        }
+        ranges.emplace_back(first, tokens.size());
+
+        for (auto const& [begin, end] : ranges) {
+            phases.push_back(body.substr(offsetOf(begin), offsetOf(end) - offsetOf(begin)));
+        }
+
+        for (size_t phase = 0; phase + 1 < ranges.size(); ++phase) {
+            const std::set<std::string_view> locals = LocalDeclarations(tokens, ranges[phase].first, ranges[phase].second);
+            for (size_t later = phase + 1; later < ranges.size(); ++later) {
+                for (size_t i = ranges[later].first; i < ranges[later].second; ++i) {
+                    if (tokens[i].Type != BodyToken::Kind::Identifier || !locals.contains(tokens[i].Text)) continue;
+                    problem = "the local " + std::string(tokens[i].Text) + " is used across a barrier";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // The locals a body has declared so far, innermost block last, with their HLSL types. The variables of a
+    // for statement's header get a block of their own, which ends with the statement.
+    class LocalScopes {
+    public:
+        struct Block {
+            std::map<std::string_view, std::string> Names = { };
+            // Set on the block of a for header: the header's parentheses closed, and the body has no braces
+            bool For = false;
+            bool HeaderClosed = false;
+            bool Braceless = false;
+            // Set on the braces of the body of a for statement, whose header block ends with them
+            bool ForBody = false;
+        };
+
+        explicit LocalScopes(std::map<std::string, std::string, std::less<>> const& parameters) : Blocks(1) {
+            for (auto const& [name, type] : parameters) Blocks[0].Names[name] = type;
+        }
+
+        Block& Innermost() { return Blocks.back(); }
+        void Push(Block block) { Blocks.push_back(std::move(block)); }
+
+        // Ends the innermost block, then the for statements whose body it was or ended with
+        void Pop() {
+            if (Blocks.size() > 1) {
+                const bool forBody = Blocks.back().ForBody;
+                Blocks.pop_back();
+                if (forBody && Blocks.size() > 1 && Blocks.back().For) Blocks.pop_back();
+            }
+            EndStatement();
+        }
+
+        // A statement ended, and with it any for statements without braces around their bodies
+        void EndStatement() {
+            while (Blocks.size() > 1 && Blocks.back().For && Blocks.back().HeaderClosed && Blocks.back().Braceless) {
+                Blocks.pop_back();
+            }
+        }
+
+        void Declare(std::string_view name, std::string type) { Blocks.back().Names[name] = std::move(type); }
+
+        // The type of a local, or null if name isn't one
+        std::string const* Find(std::string_view name) const {
+            for (auto block = Blocks.rbegin(); block != Blocks.rend(); ++block) {
+                auto found = block->Names.find(name);
+                if (found != block->Names.end()) return &found->second;
+            }
+            return nullptr;
+        }
+
+    private:
+        std::vector<Block> Blocks;
+    };
+
+    bool TranslateBody(std::string_view body, TranslationScope const& scope, std::string& out, std::string& problem) {
+        static constexpr std::string_view Keywords[] = {
+            "return", "if", "else", "for", "while", "do", "switch", "case", "default", "break", "continue", "typedef",
+        };
+        static constexpr std::string_view Qualifiers[] = { "const", "static", "precise" };
+        auto isKeyword = [](std::string_view name) { return std::find(std::begin(Keywords), std::end(Keywords), name) != std::end(Keywords); };
+        auto isQualifier = [](std::string_view name) { return std::find(std::begin(Qualifiers), std::end(Qualifiers), name) != std::end(Qualifiers); };
+
+        const std::vector<BodyToken> tokens = TokenizeBody(body);
+
+        auto previousToken = [&](size_t i) -> size_t {
+            while (i-- > 0) {
+                if (tokens[i].Type != BodyToken::Kind::Space) return i;
+            }
+            return tokens.size();
+        };
+        auto previous = [&](size_t i) -> std::string_view {
+            const size_t found = previousToken(i);
+            return found < tokens.size() ? tokens[found].Text : std::string_view();
+        };
+        auto nextToken = [&](size_t i) -> size_t {
+            while (++i < tokens.size()) {
+                if (tokens[i].Type != BodyToken::Kind::Space) return i;
+            }
+            return tokens.size();
+        };
+        auto next = [&](size_t i) -> std::string_view {
+            const size_t found = nextToken(i);
+            return found < tokens.size() ? tokens[found].Text : std::string_view();
+        };
+
+        // Any struct of the shader has a member called name
+        auto isStructMember = [&](std::string_view name) {
+            return std::any_of(scope.Structs.begin(), scope.Structs.end(), [&](auto const& type) { return type.second.contains(name); });
+        };
+
+        LocalScopes locals(scope.Parameters);
+        // Brackets open at this point, and those of each declaration's initializer, so only its own commas declare more
+        size_t nesting = 0;
+        size_t parentheses = 0;
+        // The type of the declaration whose declarators are being read, and its nesting
+        std::string declaring;
+        size_t declaringNesting = 0;
+        // A for header opened at this many parentheses, and it just closed
+        std::vector<size_t> forHeaders;
+        bool afterForHeader = false;
+        // The HLSL type of the expression ending at the last token, empty if it isn't known, and of those indexed by open brackets
+        std::string type;
+        std::vector<std::string> indexed;
+
+        // Expressions converted to a vector, as HLSL does implicitly, by wrapping them in Type(...) once they end at a
+        // comma, semicolon or closing bracket at their nesting. Those that are just a value of Type, like a local or an
+        // element of a buffer, are left alone. The next starts at the next token.
+        struct Conversion {
+            std::string Type;
+            size_t Nesting = 0;
+            size_t Begin = 0;
+            bool Operators = false;
+        };
+        std::vector<Conversion> conversions;
+        std::string convertNext;
+        auto convertIfVector = [&](std::string const& to) {
+            if (IsVector(to)) convertNext = to;
+        };
+
+        // Calls of the shader's functions whose arguments are converted to the types of their parameters
+        struct Call {
+            std::vector<std::string> const* Parameters = nullptr;
+            size_t Nesting = 0;
+            size_t Argument = 0;
+        };
+        std::vector<Call> calls;
+        std::vector<std::string> const* calling = nullptr;
+        auto startCall = [&]() {
+            if (!calling) return;
+            calls.push_back({ calling, nesting, 0 });
+            if (!calling->empty()) convertIfVector(calling->front());
+            calling = nullptr;
+        };
+
+        out.reserve(out.size() + body.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            BodyToken const& token = tokens[i];
+            if (token.Type != BodyToken::Kind::Space && afterForHeader) {
+                afterForHeader = false;
+                if (token.Text != "{") locals.Innermost().Braceless = true;
+            }
+            if (token.Type != BodyToken::Kind::Space && !convertNext.empty()) {
+                // Braces initialize the vector themselves; a call without arguments has nothing to convert
+                if (token.Text != "{" && token.Text != ")") {
+                    conversions.push_back({ std::move(convertNext), nesting, out.size() });
+                }
+                convertNext.clear();
+            }
+            if (token.Text == ";" || token.Text == "," || token.Text == ")" || token.Text == "]" || token.Text == "}") {
+                for (; !conversions.empty() && conversions.back().Nesting == nesting; conversions.pop_back()) {
+                    Conversion const& conversion = conversions.back();
+                    if (!conversion.Operators && type == conversion.Type) continue;
+                    out.insert(conversion.Begin, conversion.Type + '(');
+                    out += ')';
+                }
+            } else if (token.Type == BodyToken::Kind::Punctuator && token.Text != "." && token.Text != "[" && token.Text != "(") {
+                for (auto conversion = conversions.rbegin(); conversion != conversions.rend() && conversion->Nesting == nesting; ++conversion) {
+                    conversion->Operators = true;
+                }
+            }
+
+            switch (token.Type) {
+            case BodyToken::Kind::Number:
+                AppendNumber(token.Text, out);
+                type.clear();
+                break;
+
+            case BodyToken::Kind::Identifier: {
+                const std::string_view before = previous(i);
+                const bool member = before == ".";
+                if (const std::string_view reason = Unsupported(token.Text, member); !reason.empty()) {
+                    problem = std::string(reason) + " (" + std::string(token.Text) + ") can't run on the CPU";
+                    return false;
+                }
+
+                // A member of the expression before, which is a swizzle if that is a vector. Of an expression whose
+                // type isn't known, like a call, names of struct members are taken to be members.
+                if (member) {
+                    std::string memberType;
+                    auto structType = scope.Structs.find(type);
+                    if (structType != scope.Structs.end()) {
+                        auto found = structType->second.find(token.Text);
+                        if (found != structType->second.end()) memberType = found->second;
+                    } else if ((IsVector(type) || (type.empty() && !isStructMember(token.Text))) && IsSwizzle(token.Text)) {
+                        problem = "swizzles of more than one component (" + std::string(token.Text) + ") can't run on the CPU";
+                        return false;
+                    } else if (IsVector(type)) {
+                        memberType = type.substr(0, type.size() - 1);
+                    }
+                    out += token.Text;
+                    type = std::move(memberType);
+                    break;
+                }
+
+                if (token.Text == "return" && next(i) != ";") {
+                    out += token.Text;
+                    convertIfVector(scope.ReturnType);
+                    type.clear();
+                    break;
+                }
+
+                if (token.Text == "for" && next(i) == "(") {
+                    locals.Push({ .For = true });
+                    forHeaders.push_back(parentheses);
+                    out += token.Text;
+                    type.clear();
+                    break;
+                }
+
+                // The name of a declaration: a type at the start of a statement, or another declarator of one
+                const size_t typeToken = previousToken(i);
+                const std::string_view after = next(i);
+                const bool declarator = after == "=" || after == ";" || after == "," || after == "[";
+                bool declares = false;
+                if (declarator && !declaring.empty() && before == "," && nesting == declaringNesting) {
+                    declares = true;
+                } else if (declarator && typeToken < tokens.size() && tokens[typeToken].Type == BodyToken::Kind::Identifier &&
+                    !isKeyword(tokens[typeToken].Text) && !isQualifier(tokens[typeToken].Text)) {
+                    size_t start = previousToken(typeToken);
+                    while (start < tokens.size() && isQualifier(tokens[start].Text)) start = previousToken(start);
+                    const std::string_view opening = start < tokens.size() ? tokens[start].Text : std::string_view();
+                    if (start >= tokens.size() || opening == ";" || opening == "{" || opening == "}" ||
+                        (opening == "(" && !forHeaders.empty() && forHeaders.back() + 1 == parentheses)) {
+                        declares = true;
+                        declaring = tokens[typeToken].Text;
+                        declaringNesting = nesting;
+                    }
+                }
+                if (declares) {
+                    std::string declared = declaring;
+                    for (size_t j = nextToken(i); j < tokens.size() && tokens[j].Text == "["; j = nextToken(j)) {
+                        declared += "[]";
+                        while (j < tokens.size() && tokens[j].Text != "]") ++j;
+                    }
+                    out += token.Text;
+                    type = declared;
+                    locals.Declare(token.Text, std::move(declared));
+                    break;
+                }
+
+                if (std::string const* local = locals.Find(token.Text)) {
+                    out += token.Text;
+                    type = *local;
+                } else if (after == "(" && IsIntrinsic(token.Text)) {
+                    out += "VectorConfig::";
+                    out += token.Text;
+                    type.clear();
+                } else if (after == "(" && !scope.ImplicitArgument.empty() && scope.Functions.contains(token.Text)) {
+                    out += token.Text;
+                    while (tokens[++i].Text != "(") { }
+                    ++nesting;
+                    ++parentheses;
+                    indexed.push_back({ });
+                    out += '(';
+                    out += scope.ImplicitArgument;
+                    if (next(i) != ")") out += ", ";
+                    if (auto parameters = scope.FunctionParameters.find(token.Text); parameters != scope.FunctionParameters.end()) {
+                        calling = &parameters->second;
+                        startCall();
+                    }
+                    type.clear();
+                } else if (after == "(" && scope.FunctionParameters.contains(token.Text)) {
+                    out += token.Text;
+                    calling = &scope.FunctionParameters.find(token.Text)->second;
+                    type.clear();
+                } else if (auto global = scope.Globals.find(token.Text); global != scope.Globals.end()) {
+                    out += global->second;
+                    auto globalType = scope.Types.find(token.Text);
+                    type = globalType != scope.Types.end() ? globalType->second : std::string();
+                } else {
+                    out += token.Text;
+                    auto globalType = scope.Types.find(token.Text);
+                    type = globalType != scope.Types.end() ? globalType->second : std::string();
+                }
+                break;
+            }
+
+            case BodyToken::Kind::Punctuator: {
+                // Attributes like [unroll] or [loop] start a statement; C++ has no use for them
+                const std::string_view before = previous(i);
+                if (token.Text == "[" && (before.empty() || before == ";" || before == "{" || before == "}")) {
+                    size_t close = i;
+                    size_t depth = 0;
+                    for (; close < tokens.size(); ++close) {
+                        if (tokens[close].Text == "[") ++depth;
+                        else if (tokens[close].Text == "]" && --depth == 0) break;
+                    }
+                    if (close < tokens.size()) {
+                        i = close;
+                        break;
+                    }
+                }
+                out += token.Text;
+
+                const std::string_view text = token.Text;
+                if (text == "[" || text == "(" || text == "{") {
+                    ++nesting;
+                    indexed.push_back(text == "[" ? type : std::string());
+                    if (text == "(") {
+                        ++parentheses;
+                        startCall();
+                    }
+                    if (text == "{") {
+                        const bool forBody = locals.Innermost().For && locals.Innermost().HeaderClosed && !locals.Innermost().Braceless;
+                        locals.Push({ .ForBody = forBody });
+                    }
+                    type.clear();
+                } else if (text == "]" || text == ")" || text == "}") {
+                    if (!calls.empty() && calls.back().Nesting == nesting) calls.pop_back();
+                    if (nesting > 0) --nesting;
+                    const std::string base = indexed.empty() ? std::string() : std::move(indexed.back());
+                    if (!indexed.empty()) indexed.pop_back();
+                    type = text == "]" ? ElementType(base) : std::string();
+                    if (text == ")" && parentheses > 0) {
+                        --parentheses;
+                        if (!forHeaders.empty() && forHeaders.back() == parentheses) {
+                            forHeaders.pop_back();
+                            locals.Innermost().HeaderClosed = true;
+                            afterForHeader = true;
+                        }
+                    }
+                    if (text == "}") {
+                        locals.Pop();
+                        declaring.clear();
+                    }
+                } else if (text == ";") {
+                    if (nesting == declaringNesting) declaring.clear();
+                    if (parentheses == 0) locals.EndStatement();
+                    type.clear();
+                } else if (text == "," && !calls.empty() && calls.back().Nesting == nesting) {
+                    Call& call = calls.back();
+                    if (++call.Argument < call.Parameters->size()) convertIfVector((*call.Parameters)[call.Argument]);
+                    type.clear();
+                } else if (text == "=" && IsAssignment(tokens, i)) {
+                    convertIfVector(type);
+                    type.clear();
+                } else if (text != ".") {
+                    type.clear();
+                }
+                break;
+            }
+
+            case BodyToken::Kind::Space:
+                out += token.Text;
+                break;
+            }
+        }
+        for (; !conversions.empty(); conversions.pop_back()) {
+            out.insert(conversions.back().Begin, conversions.back().Type + '(');
+            out += ')';
+        }
+        return true;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <string_view>
+
+namespace ReflectHLSL {
+    // The text between the braces of the definition of function name in source, the expanded shader the
+    // Program was parsed from. Declarations without a body are skipped. A null view, unlike an empty body,
+    // if there is no definition.
+    std::string_view FindFunctionBody(std::string_view source, std::string_view name);
+
+    // Names a translated body sees differently in C++
+    struct TranslationScope {
+        // cbuffer members, which HLSL names as globals, and the expression reaching them in the Program
+        std::map<std::string, std::string, std::less<>> Globals;
+
+        // HLSL types of the Globals and of the Program's buffers, and the member types of the shader's structs, so
+        // only members of vectors are taken for swizzles. Arrays and buffers end in [] per dimension, like Light[].
+        std::map<std::string, std::string, std::less<>> Types;
+        std::map<std::string, std::map<std::string, std::string, std::less<>>, std::less<>> Structs;
+
+        // The parameters of the function being translated and their types, which hide Globals of the same name
+        std::map<std::string, std::string, std::less<>> Parameters;
+        std::string ReturnType;
+
+        // The parameter types of the shader's functions that have one definition, empty for out and inout ones, so
+        // scalars passed for vectors are converted. Functions not in it get their arguments as written.
+        std::map<std::string, std::vector<std::string>, std::less<>> FunctionParameters;
+
+        // The shader's functions, which are passed ImplicitArgument ahead of their own arguments unless it's empty
+        std::set<std::string, std::less<>> Functions;
+        std::string ImplicitArgument;
+    };
+
+    // Splits the body of a kernel at the barriers that sync the group, like GroupMemoryBarrierWithGroupSync(),
+    // into phases that run for every lane of the group before the next phase starts. Returns false, with the
+    // reason in problem, if a local declared by one phase is used by a later one, since lanes don't keep their
+    // locals between phases. Barriers inside blocks are left in their phase, where TranslateBody rejects them.
+    bool SplitAtBarriers(std::string_view body, std::vector<std::string_view>& phases, std::string& problem);
+
+    // Rewrites an HLSL function body as the body of a C++ member function of the generated Program:
+    // attributes like [unroll] are dropped, float literals get an f suffix, intrinsics like lerp are called
+    // through VectorConfig and cbuffer and groupshared variables are reached through scope.Globals, unless a
+    // parameter or local of the same name hides them. What HLSL converts to a vector implicitly, like the 0 of
+    // float3 v = 0;, is converted explicitly when it is assigned to a vector, returned as one or passed for a
+    // parameter in scope.FunctionParameters. Returns false, with the reason in problem, for what has
+    // no CPU equivalent: swizzles of more than one component, barriers left by SplitAtBarriers, atomics, wave
+    // operations and texture access.
+    bool TranslateBody(std::string_view body, TranslationScope const& scope, std::string& out, std::string& problem);
+}
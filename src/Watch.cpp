@@ -0,0 +1,167 @@
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "Tool.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+// How long the tree has to be quiet before a batch of changes is processed.
+// Editors often save through several writes and renames in a row.
+static constexpr int DebounceMs = 50;
+
+class DirectoryWatcher {
+public:
+    DirectoryWatcher() : Fd(inotify_init1(IN_CLOEXEC)) { }
+
+    ~DirectoryWatcher() {
+        if (Fd >= 0) close(Fd);
+    }
+
+    DirectoryWatcher(DirectoryWatcher const&) = delete;
+    DirectoryWatcher& operator=(DirectoryWatcher const&) = delete;
+
+    bool Valid() const { return Fd >= 0; }
+
+    bool IncludeChanged = false;
+
+    // inotify is not recursive, so every directory gets its own watch
+    void AddTree(std::filesystem::path const& root) {
+        Add(root);
+
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_directory()) {
+                Add(it->path());
+            }
+        }
+    }
+
+    // Blocks until something changed, then collects events until the tree is quiet
+    // for DebounceMs. Returns the shaders whose source or .spv changed.
+    // IncludeChanged is set if a header changed too, which any shader may include.
+    std::set<std::filesystem::path> WaitForChanges() {
+        std::set<std::filesystem::path> changed;
+        int timeout = -1;
+
+        for (;;) {
+            pollfd pfd = { Fd, POLLIN, 0 };
+            const int ready = poll(&pfd, 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                return changed;
+            }
+            if (ready == 0) {
+                if (!changed.empty() || IncludeChanged) return changed;
+                timeout = -1;
+                continue;
+            }
+
+            ReadEvents(changed);
+            timeout = DebounceMs;
+        }
+    }
+
+private:
+    void Add(std::filesystem::path const& dir) {
+        const int wd = inotify_add_watch(Fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF);
+        if (wd >= 0) {
+            Dirs[wd] = dir;
+        }
+    }
+
+    void ReadEvents(std::set<std::filesystem::path>& changed) {
+        alignas(inotify_event) char buffer[16 * 1024];
+        const ssize_t length = read(Fd, buffer, sizeof(buffer));
+        if (length <= 0) return;
+
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto dir = Dirs.find(event->wd);
+            if (dir == Dirs.end()) continue;
+
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                Dirs.erase(dir);
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            std::filesystem::path path = dir->second / event->name;
+
+            if (event->mask & IN_ISDIR) {
+                // Shaders can be created inside it before the watch is in place, so look at what's already there
+                AddTree(path);
+                std::error_code ec;
+                for (auto it = std::filesystem::recursive_directory_iterator(path, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                    if (it->is_regular_file() && IsShaderSource(it->path())) {
+                        changed.insert(it->path());
+                    }
+                }
+                continue;
+            }
+
+            // A plain IN_CREATE is followed by IN_CLOSE_WRITE once the file is written
+            if (!(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) continue;
+
+            if (IsShaderInclude(path)) {
+                IncludeChanged = true;
+                continue;
+            }
+
+            // shader.comp.spv belongs to shader.comp
+            if (path.extension() == ".spv") {
+                path.replace_extension();
+            }
+
+            if (IsShaderSource(path) && std::filesystem::is_regular_file(path)) {
+                changed.insert(path);
+            }
+        }
+    }
+
+    int Fd;
+    std::map<int, std::filesystem::path> Dirs;
+};
+
+int WatchDir(std::filesystem::path watchDirectory, size_t jobs) {
+    DirectoryWatcher watcher;
+    if (!watcher.Valid()) {
+        std::cerr << "Failed to start watching " << watchDirectory.string() << std::endl;
+        return 1;
+    }
+
+    // Watch before the first scan, so nothing saved during it is missed
+    watcher.AddTree(watchDirectory);
+
+    ScanDir(watchDirectory, jobs);
+    SaveBuildCache();
+
+    for (;;) {
+        const std::set<std::filesystem::path> changed = watcher.WaitForChanges();
+
+        if (watcher.IncludeChanged) {
+            // Which shaders include the header isn't tracked; the build cache skips those whose expansion is unchanged
+            watcher.IncludeChanged = false;
+            ScanDir(watchDirectory, jobs);
+        } else if (changed.empty()) {
+            return 1;
+        } else {
+            ProcessFiles(std::vector<std::filesystem::path>(changed.begin(), changed.end()), jobs);
+        }
+        SaveBuildCache();
+    }
+}
+#else
+int WatchDir(std::filesystem::path watchDirectory, size_t) {
+    std::cerr << "-watch is only supported on Linux, can't watch " << watchDirectory.string() << std::endl;
+    return 1;
+}
+#endif
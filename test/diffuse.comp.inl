@@ -0,0 +1,82 @@
+#include "light.hlsli.ee03878326721c9b.inl"
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct Generator {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	using Include0 = typename ReflectHLSL_Include_light_hlsli_ee03878326721c9b<VectorConfig, BufferConfig, TextureConfig, Context>::Program;
+
+	struct Program : Include0 {
+		using typename Include0::Light;
+		using typename Include0::LightConstants;
+		StructuredBuffer<float3> Normals; // : register
+		RWStructuredBuffer<float> Shade; // : register
+
+		// void
+		// - uint3 id
+		static constexpr uint3 InvokeSize = uint3(64, 1, 1);
+
+		inline Program(Context& ctx)
+		: Include0(ctx)
+		, Normals(ctx, "Normals", "t0")
+		, Shade(ctx, "Shade", "u0")
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 2> OwnBindings = { {
+			{ "Normals", ReflectedBinding::ShaderResource, 0, 0, 1 },
+			{ "Shade", ReflectedBinding::UnorderedAccess, 0, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(Include0::Bindings, OwnBindings);
+
+		static constexpr size_t BytecodeSize = 0;
+		static constexpr uint8_t Bytecode[] = {
+			
+		};
+	};
+};
@@ -0,0 +1,15 @@
+//--------------------------------------------------------------------------------------
+// A header two shaders share. test/light.hlsli.<version>.inl is generated from it, once for both.
+//--------------------------------------------------------------------------------------
+
+struct Light
+{
+    float3 direction;
+    float intensity;
+};
+
+cbuffer LightConstants : register(b0)
+{
+    Light sun;
+    float4 ambient;
+};
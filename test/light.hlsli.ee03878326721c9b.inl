@@ -0,0 +1,88 @@
+// Declarations of light.hlsli shared by the shaders including it with the same macros defined
+
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct ReflectHLSL_Include_light_hlsli_ee03878326721c9b {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	struct Program {
+		struct alignas(16) Light {
+			float3 direction;
+			float intensity;
+			static constexpr uint32_t GpuSize = 16;
+			static constexpr std::array<ReflectedMember, 2> Members = { {
+				{ "direction", "float3", 0, 12, 0, { }, "" },
+				{ "intensity", "float", 12, 4, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(Light) == 16);
+		static_assert(offsetof(Light, direction) == 0);
+		static_assert(offsetof(Light, intensity) == 12);
+		struct alignas(16) LightConstants { // : register
+			Light sun;
+			float4 ambient;
+			static constexpr uint32_t GpuSize = 32;
+			static constexpr std::array<ReflectedMember, 2> Members = { {
+				{ "sun", "Light", 0, 16, 0, { }, "" },
+				{ "ambient", "float4", 16, 16, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(LightConstants) == 32);
+		static_assert(offsetof(LightConstants, sun) == 0);
+		static_assert(offsetof(LightConstants, ambient) == 16);
+
+		inline Program(Context& ctx)
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 1> OwnBindings = { {
+			{ "LightConstants", ReflectedBinding::ConstantBuffer, 0, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(OwnBindings);
+	};
+};
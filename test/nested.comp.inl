@@ -0,0 +1,118 @@
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct Generator {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	struct Program {
+		struct alignas(16) Fog {
+			float3 color;
+			float density;
+			static constexpr uint32_t GpuSize = 16;
+			static constexpr std::array<ReflectedMember, 2> Members = { {
+				{ "color", "float3", 0, 12, 0, { }, "" },
+				{ "density", "float", 12, 4, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(Fog) == 16);
+		static_assert(offsetof(Fog, color) == 0);
+		static_assert(offsetof(Fog, density) == 12);
+		struct alignas(16) Ramp {
+			float start;
+			uint8_t _padding0[12];
+			float3 offset;
+			uint8_t _padding1[4];
+			static constexpr uint32_t GpuSize = 32;
+			static constexpr std::array<ReflectedMember, 2> Members = { {
+				{ "start", "float", 0, 4, 0, { }, "" },
+				{ "offset", "float3", 16, 12, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(Ramp) == 32);
+		static_assert(offsetof(Ramp, start) == 0);
+		static_assert(offsetof(Ramp, offset) == 16);
+		struct alignas(16) FogConstants { // : register
+			float time;
+			uint8_t _padding0[12];
+			Fog fog;
+			float exposure;
+			uint8_t _padding1[12];
+			static constexpr uint32_t GpuSize = 48;
+			static constexpr std::array<ReflectedMember, 3> Members = { {
+				{ "time", "float", 0, 4, 0, { }, "" },
+				{ "fog", "Fog", 16, 16, 0, { }, "" },
+				{ "exposure", "float", 32, 4, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(FogConstants) == 48);
+		static_assert(offsetof(FogConstants, time) == 0);
+		static_assert(offsetof(FogConstants, fog) == 16);
+		static_assert(offsetof(FogConstants, exposure) == 32);
+		struct RampConstants { // : register
+			// No GPU layout: cbuffer packing places the members of Ramp differently than its own layout
+			Ramp ramp;
+			static constexpr std::array<ReflectedMember, 1> Members = { {
+				{ "ramp", "Ramp", ReflectedMember::Unknown, ReflectedMember::Unknown, 0, { }, "" },
+			} };
+		};
+
+		inline Program(Context& ctx)
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 2> OwnBindings = { {
+			{ "FogConstants", ReflectedBinding::ConstantBuffer, 0, 0, 1 },
+			{ "RampConstants", ReflectedBinding::ConstantBuffer, 1, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(OwnBindings);
+
+		static constexpr size_t BytecodeSize = 0;
+		static constexpr uint8_t Bytecode[] = {
+			
+		};
+	};
+};
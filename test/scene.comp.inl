@@ -0,0 +1,168 @@
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct Generator {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	struct Program {
+		struct alignas(16) LightState {
+			float4 position;
+			float4 direction;
+			float4 color;
+			float4 falloff;
+			float4x4 view;
+			float4x4 projection;
+			static constexpr uint32_t GpuSize = 192;
+			static constexpr std::array<ReflectedMember, 6> Members = { {
+				{ "position", "float4", 0, 16, 0, { }, "" },
+				{ "direction", "float4", 16, 16, 0, { }, "" },
+				{ "color", "float4", 32, 16, 0, { }, "" },
+				{ "falloff", "float4", 48, 16, 0, { }, "" },
+				{ "view", "float4x4", 64, 64, 0, { }, "" },
+				{ "projection", "float4x4", 128, 64, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(LightState) == 192);
+		static_assert(offsetof(LightState, position) == 0);
+		static_assert(offsetof(LightState, direction) == 16);
+		static_assert(offsetof(LightState, color) == 32);
+		static_assert(offsetof(LightState, falloff) == 48);
+		static_assert(offsetof(LightState, view) == 64);
+		static_assert(offsetof(LightState, projection) == 128);
+		// LightState with setters recording what they change, for uploading only that
+		struct LightStateTracked {
+			LightState Data = { };
+			DirtyRanges Dirty;
+
+			void set_position(decltype(LightState::position) const& value) { Data.position = value; Dirty.Mark(0, 16); }
+			void set_direction(decltype(LightState::direction) const& value) { Data.direction = value; Dirty.Mark(16, 16); }
+			void set_color(decltype(LightState::color) const& value) { Data.color = value; Dirty.Mark(32, 16); }
+			void set_falloff(decltype(LightState::falloff) const& value) { Data.falloff = value; Dirty.Mark(48, 16); }
+			void set_view(decltype(LightState::view) const& value) { Data.view = value; Dirty.Mark(64, 64); }
+			void set_projection(decltype(LightState::projection) const& value) { Data.projection = value; Dirty.Mark(128, 64); }
+
+			// Calls upload(offset, source, size) for each region of changed bytes, see DirtyRanges::Flush
+			template<typename Upload>
+			size_t Flush(Upload&& upload, size_t alignment = 1) {
+				const std::byte* bytes = reinterpret_cast<const std::byte*>(&Data);
+				return Dirty.Flush([&](size_t offset, size_t size) { upload(offset, bytes + offset, size); }, alignment, sizeof(Data));
+			}
+
+			// Copies the changed bytes to the same offsets of destination, the mapped copy
+			size_t FlushTo(void* destination, size_t alignment = 1) {
+				return Flush([&](size_t offset, const void* source, size_t size) { std::memcpy(static_cast<std::byte*>(destination) + offset, source, size); }, alignment);
+			}
+		};
+		struct alignas(16) SceneConstantBuffer { // : register
+			float4x4 model;
+			float4x4 view;
+			float4x4 projection;
+			float4 ambientColor;
+			uint sampleShadowMap;
+			uint8_t _padding0[12];
+			LightState lights[16];
+			static constexpr uint32_t GpuSize = 3296;
+			static constexpr std::array<ReflectedMember, 6> Members = { {
+				{ "model", "float4x4", 0, 64, 0, { }, "" },
+				{ "view", "float4x4", 64, 64, 0, { }, "" },
+				{ "projection", "float4x4", 128, 64, 0, { }, "" },
+				{ "ambientColor", "float4", 192, 16, 0, { }, "" },
+				{ "sampleShadowMap", "uint", 208, 4, 0, { }, "" },
+				{ "lights", "LightState", 224, 3072, 1, { 16 }, "" },
+			} };
+		};
+		static_assert(sizeof(SceneConstantBuffer) == 3296);
+		static_assert(offsetof(SceneConstantBuffer, model) == 0);
+		static_assert(offsetof(SceneConstantBuffer, view) == 64);
+		static_assert(offsetof(SceneConstantBuffer, projection) == 128);
+		static_assert(offsetof(SceneConstantBuffer, ambientColor) == 192);
+		static_assert(offsetof(SceneConstantBuffer, sampleShadowMap) == 208);
+		static_assert(offsetof(SceneConstantBuffer, lights) == 224);
+		// SceneConstantBuffer with setters recording what they change, for uploading only that
+		struct SceneConstantBufferTracked {
+			SceneConstantBuffer Data = { };
+			DirtyRanges Dirty;
+
+			void set_model(decltype(SceneConstantBuffer::model) const& value) { Data.model = value; Dirty.Mark(0, 64); }
+			void set_view(decltype(SceneConstantBuffer::view) const& value) { Data.view = value; Dirty.Mark(64, 64); }
+			void set_projection(decltype(SceneConstantBuffer::projection) const& value) { Data.projection = value; Dirty.Mark(128, 64); }
+			void set_ambientColor(decltype(SceneConstantBuffer::ambientColor) const& value) { Data.ambientColor = value; Dirty.Mark(192, 16); }
+			void set_sampleShadowMap(decltype(SceneConstantBuffer::sampleShadowMap) const& value) { Data.sampleShadowMap = value; Dirty.Mark(208, 4); }
+			void set_lights(decltype(SceneConstantBuffer::lights) const& value) { std::memcpy(&Data.lights, &value, sizeof(value)); Dirty.Mark(224, 3072); }
+			void set_lights(size_t index, std::remove_extent_t<decltype(SceneConstantBuffer::lights)> const& value) { assert(index < std::extent_v<decltype(SceneConstantBuffer::lights)> && "lights index out of range"); std::memcpy(&Data.lights[index], &value, sizeof(value)); Dirty.Mark(224 + index * sizeof(value), sizeof(value)); }
+
+			// Calls upload(offset, source, size) for each region of changed bytes, see DirtyRanges::Flush
+			template<typename Upload>
+			size_t Flush(Upload&& upload, size_t alignment = 1) {
+				const std::byte* bytes = reinterpret_cast<const std::byte*>(&Data);
+				return Dirty.Flush([&](size_t offset, size_t size) { upload(offset, bytes + offset, size); }, alignment, sizeof(Data));
+			}
+
+			// Copies the changed bytes to the same offsets of destination, the mapped cbuffer
+			size_t FlushTo(void* destination, size_t alignment = 1) {
+				return Flush([&](size_t offset, const void* source, size_t size) { std::memcpy(static_cast<std::byte*>(destination) + offset, source, size); }, alignment);
+			}
+		};
+		RWStructuredBuffer<LightState> Lights; // : register
+
+		inline Program(Context& ctx)
+		: Lights(ctx, "Lights", "u0")
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 2> OwnBindings = { {
+			{ "SceneConstantBuffer", ReflectedBinding::ConstantBuffer, 0, 0, 1 },
+			{ "Lights", ReflectedBinding::UnorderedAccess, 0, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(OwnBindings);
+
+		static constexpr size_t BytecodeSize = 0;
+		static constexpr uint8_t Bytecode[] = {
+			
+		};
+	};
+};
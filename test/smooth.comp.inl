@@ -0,0 +1,134 @@
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct Generator {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	struct Program {
+		struct alignas(16) Params { // : register
+			uint count;
+			uint rounds;
+			uint8_t _padding0[8];
+			static constexpr uint32_t GpuSize = 16;
+			static constexpr std::array<ReflectedMember, 2> Members = { {
+				{ "count", "uint", 0, 4, 0, { }, "" },
+				{ "rounds", "uint", 4, 4, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(Params) == 16);
+		static_assert(offsetof(Params, count) == 0);
+		static_assert(offsetof(Params, rounds) == 4);
+		StructuredBuffer<float> X; // : register
+		RWStructuredBuffer<float> Y; // : register
+
+		// void
+		// - uint3 id
+		// - uint index
+		static constexpr uint3 InvokeSize = uint3(64, 1, 1);
+
+		inline Program(Context& ctx)
+		: X(ctx, "X", "t0")
+		, Y(ctx, "Y", "u0")
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 3> OwnBindings = { {
+			{ "Params", ReflectedBinding::ConstantBuffer, 0, 0, 1 },
+			{ "X", ReflectedBinding::ShaderResource, 0, 0, 1 },
+			{ "Y", ReflectedBinding::UnorderedAccess, 0, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(OwnBindings);
+
+		// CPU versions of the shader's functions
+		Params ParamsData = { };
+
+		// The groupshared memory of one workgroup. Dispatch keeps one per worker thread and reuses it for every group.
+		struct GroupShared {
+			float Cache[64];
+		};
+
+		void CSMainPhase0(GroupShared& Shared, uint3 id, uint index) {
+			Shared.Cache[index] = id.x < ParamsData.count ? X[id.x] : 0.0f;
+		}
+
+		void CSMainPhase1(GroupShared& Shared, uint3 id, uint index) {
+			float v = (Shared.Cache[(index + 63) % 64] + Shared.Cache[index] + Shared.Cache[(index + 1) % 64]) / 3.0f;
+			for (uint i = 0; i < ParamsData.rounds; ++i)
+			{
+				v = v * 0.5f + 0.25f * VectorConfig::sin(v);
+			}
+			if (id.x < ParamsData.count)
+			{
+				Y[id.x] = v;
+			}
+		}
+
+		// Runs every lane of workgroup (groupX, groupY, groupZ) on the calling thread, one after another, phase by phase
+		// when the kernel has barriers.
+		void RunGroup(uint32_t groupX, uint32_t groupY, uint32_t groupZ, GroupShared& Shared) {
+			for (uint32_t z = 0; z < 1; ++z) {
+				for (uint32_t y = 0; y < 1; ++y) {
+					for (uint32_t x = 0; x < 64; ++x) {
+						CSMainPhase0(Shared, uint3(groupX * 64 + x, groupY * 1 + y, groupZ * 1 + z), (z * 1 + y) * 64 + x);
+					}
+				}
+			}
+			for (uint32_t z = 0; z < 1; ++z) {
+				for (uint32_t y = 0; y < 1; ++y) {
+					for (uint32_t x = 0; x < 64; ++x) {
+						CSMainPhase1(Shared, uint3(groupX * 64 + x, groupY * 1 + y, groupZ * 1 + z), (z * 1 + y) * 64 + x);
+					}
+				}
+			}
+		}
+
+		static constexpr size_t BytecodeSize = 0;
+		static constexpr uint8_t Bytecode[] = {
+			
+		};
+	};
+};
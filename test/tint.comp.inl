@@ -0,0 +1,134 @@
+// Inside a namespace of its own, this file needs ReflectHLSLRuntime.hpp included at global scope first
+#include "ReflectHLSLRuntime.hpp"
+
+template<
+	typename VectorConfig,
+	typename BufferConfig,
+	typename TextureConfig,
+	typename Context
+>
+struct Generator {
+	using float1 = float;
+	using float2 = typename VectorConfig::template Vector<2, float>::Type;
+	using float3 = typename VectorConfig::template Vector<3, float>::Type;
+	using float4 = typename VectorConfig::template Vector<4, float>::Type;
+	using int1 = int32_t;
+	using int2 = typename VectorConfig::template Vector<2, int32_t>::Type;
+	using int3 = typename VectorConfig::template Vector<3, int32_t>::Type;
+	using int4 = typename VectorConfig::template Vector<4, int32_t>::Type;
+	using uint = uint32_t;
+	using uint1 = uint32_t;
+	using uint2 = typename VectorConfig::template Vector<2, uint32_t>::Type;
+	using uint3 = typename VectorConfig::template Vector<3, uint32_t>::Type;
+	using uint4 = typename VectorConfig::template Vector<4, uint32_t>::Type;
+	using double1 = double;
+	using double2 = typename VectorConfig::template Vector<2, double>::Type;
+	using double3 = typename VectorConfig::template Vector<3, double>::Type;
+	using double4 = typename VectorConfig::template Vector<4, double>::Type;
+	using float4x4 = typename VectorConfig::template Matrix<4, 4, float>::Type;
+
+	using ReflectedMember = ::ReflectHLSL::ReflectedMember;
+	using ReflectedBinding = ::ReflectHLSL::ReflectedBinding;
+	using DirtyRanges = ::ReflectHLSL::DirtyRanges;
+
+	template<typename... Columns>
+	using ColumnStorage = ::ReflectHLSL::ColumnStorage<Columns...>;
+
+	template<typename T>
+	using TrackedElements = ::ReflectHLSL::TrackedElements<T>;
+
+	template<typename T>
+	using StructuredBuffer = typename BufferConfig::template Buffer<T>::Type;
+
+	template<typename T>
+	using RWStructuredBuffer = typename BufferConfig::template RWBuffer<T>::Type;
+
+	template<typename T>
+	using Texture2D = typename TextureConfig::template Texture2D<T>::Type;
+
+	template<typename T>
+	using RWTexture2D = typename TextureConfig::template RWTexture2D<T>::Type;
+
+	struct Program {
+		struct alignas(16) Params { // : register
+			float3 tint;
+			float amount;
+			uint count;
+			uint8_t _padding0[12];
+			static constexpr uint32_t GpuSize = 32;
+			static constexpr std::array<ReflectedMember, 3> Members = { {
+				{ "tint", "float3", 0, 12, 0, { }, "" },
+				{ "amount", "float", 12, 4, 0, { }, "" },
+				{ "count", "uint", 16, 4, 0, { }, "" },
+			} };
+		};
+		static_assert(sizeof(Params) == 32);
+		static_assert(offsetof(Params, tint) == 0);
+		static_assert(offsetof(Params, amount) == 12);
+		static_assert(offsetof(Params, count) == 16);
+		StructuredBuffer<float3> Colors; // : register
+		RWStructuredBuffer<float3> Tinted; // : register
+
+		// float3
+		// - float3 color
+		// - float3 target
+		// - float t
+		// void
+		// - uint3 id
+		static constexpr uint3 InvokeSize = uint3(64, 1, 1);
+
+		inline Program(Context& ctx)
+		: Colors(ctx, "Colors", "t0")
+		, Tinted(ctx, "Tinted", "u0")
+		{ }
+
+		static constexpr std::array<ReflectedBinding, 3> OwnBindings = { {
+			{ "Params", ReflectedBinding::ConstantBuffer, 0, 0, 1 },
+			{ "Colors", ReflectedBinding::ShaderResource, 0, 0, 1 },
+			{ "Tinted", ReflectedBinding::UnorderedAccess, 0, 0, 1 },
+		} };
+		static constexpr auto Bindings = ::ReflectHLSL::JoinBindings(OwnBindings);
+
+		// CPU versions of the shader's functions
+		Params ParamsData = { };
+
+		// The groupshared memory of one workgroup. Dispatch keeps one per worker thread and reuses it for every group.
+		struct GroupShared {
+		};
+
+		float3 Towards(float3 color, float3 target, float t) {
+			if (t <= 0.0f)
+			return float3(0);
+			return float3(VectorConfig::lerp(color, target, t));
+		}
+
+		void CSMain(uint3 id) {
+			if (id.x >= ParamsData.count)
+			return;
+			float3 color = float3(0);
+			color = Colors[id.x];
+			float3 gray = float3(VectorConfig::dot(color, float3(0.25f, 0.5f, 0.25f)));
+			color = float3(Towards(color, gray, 0.5f));
+			color = float3(Towards(color, float3(1), ParamsData.amount));
+			Tinted[id.x] = float3(color * ParamsData.tint);
+		}
+
+		// Runs every lane of workgroup (groupX, groupY, groupZ) on the calling thread, one after another, phase by phase
+		// when the kernel has barriers.
+		void RunGroup(uint32_t groupX, uint32_t groupY, uint32_t groupZ, GroupShared& Shared) {
+			(void)Shared;
+			for (uint32_t z = 0; z < 1; ++z) {
+				for (uint32_t y = 0; y < 1; ++y) {
+					for (uint32_t x = 0; x < 64; ++x) {
+						CSMain(uint3(groupX * 64 + x, groupY * 1 + y, groupZ * 1 + z));
+					}
+				}
+			}
+		}
+
+		static constexpr size_t BytecodeSize = 0;
+		static constexpr uint8_t Bytecode[] = {
+			
+		};
+	};
+};